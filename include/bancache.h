@@ -26,13 +26,13 @@
 #pragma once
 
 /** Stores a cached ban entry.
- * Each ban has one of these hashed in a hash_map to make for faster removal
+ * Each ban has one of these hashed by IP address to make for faster removal
  * of already-banned users in the case that they try to reconnect. As no wildcard
  * matching is done on these IPs, the speed of the system is improved. These cache
  * entries expire every few hours, which is a reasonable expiry for any reasonable
  * sized network.
  */
-class CoreExport BanCacheHit
+class CoreExport BanCacheHit final
 {
  public:
 	/** Type of cached ban
@@ -51,32 +51,116 @@ class CoreExport BanCacheHit
 };
 
 /** A manager for ban cache, which allocates and deallocates and checks cached bans.
+ * The cache holds at most a configured number of entries and evicts the least recently
+ * used entry when it is full. Entries are invalidated in bulk by advancing a generation
+ * counter rather than by searching the cache for entries to remove.
  */
-class CoreExport BanCacheManager
+class CoreExport BanCacheManager final
 {
-	/** A container of ban cache items.
-	 */
-	typedef std::unordered_map<std::string, BanCacheHit*, std::hash<std::string> > BanCacheHash;
+ private:
+	/** An entry in the ban cache. */
+	struct Entry final
+	{
+		/** The address that this entry is for. */
+		irc::sockets::cidr_mask address;
+
+		/** The cached ban. */
+		BanCacheHit hit;
+
+		/** The generation counter which invalidates this entry when it changes. */
+		const unsigned long* generation;
+
+		/** The value of the generation counter when this entry was added. */
+		unsigned long created;
+
+		Entry(const irc::sockets::cidr_mask& addr, const std::string& type, const std::string& reason, time_t seconds, const unsigned long* gen);
+	};
+
+	/** Hashes the address of a ban cache entry. */
+	struct AddressHash final
+	{
+		size_t operator()(const irc::sockets::cidr_mask& address) const;
+	};
+
+	/** Ban cache entries ordered from most to least recently used. */
+	typedef std::list<Entry> EntryList;
 
+	/** A container of ban cache entries keyed by address. */
+	typedef std::unordered_map<irc::sockets::cidr_mask, EntryList::iterator, AddressHash> BanCacheHash;
+
+	/** The entries in the ban cache. */
+	EntryList entries;
+
+	/** Maps addresses to their entry in the ban cache. */
 	BanCacheHash BanHash;
-	bool RemoveIfExpired(BanCacheHash::iterator& it);
 
- public:
+	/** The generation counters for positive hits keyed by X-line type. */
+	std::unordered_map<std::string, unsigned long> positivegens;
+
+	/** The generation counter for negative hits. */
+	unsigned long negativegen = 0;
+
+	/** The number of lookups which found a valid entry. */
+	unsigned long hits = 0;
+
+	/** The number of lookups which did not find a valid entry. */
+	unsigned long misses = 0;
+
+	/** The number of entries which have been removed to make room for a new entry. */
+	unsigned long evictions = 0;
 
+	/** Converts an address to the key used for the ban cache.
+	 * @param sa The address to convert.
+	 * @param key The location to store the key.
+	 * @return True if the address can be cached; otherwise, false.
+	 */
+	static bool GetKey(const irc::sockets::sockaddrs& sa, irc::sockets::cidr_mask& key);
+
+	/** Determines whether an entry is still valid.
+	 * @param entry The entry to check.
+	 */
+	static bool IsValid(const Entry& entry);
+
+	/** Removes an entry from the ban cache.
+	 * @param it The location of the entry in the hash map.
+	 */
+	void RemoveEntry(BanCacheHash::iterator it);
+
+	/** Removes least recently used entries until the cache is below the configured size. */
+	void Trim(size_t maxsize);
+
+ public:
 	/** Creates and adds a Ban Cache item.
-	 * @param ip The IP the item is for.
+	 * @param sa The address the item is for.
 	 * @param type The type of ban cache item. std::string. .empty() means it's a negative match (user is allowed freely).
 	 * @param reason The reason for the ban. Left .empty() if it's a negative match.
 	 * @param seconds Number of seconds before nuking the bancache entry, the default is a day. This might seem long, but entries will be removed as G-lines/etc expire.
+	 * @return The new item or nullptr if the address already has an item or can not be cached.
+	 */
+	BanCacheHit* AddHit(const irc::sockets::sockaddrs& sa, const std::string& type, const std::string& reason, time_t seconds = 0);
+
+	/** Retrieves the Ban Cache item for an address.
+	 * @param sa The address to look up.
+	 * @return The item for the address or nullptr if there is no valid item.
 	 */
-	BanCacheHit *AddHit(const std::string &ip, const std::string &type, const std::string &reason, time_t seconds = 0);
-	BanCacheHit *GetHit(const std::string &ip);
+	BanCacheHit* GetHit(const irc::sockets::sockaddrs& sa);
 
-	/** Removes all entries of a given type, either positive or negative. Returns the number of hits removed.
+	/** Removes all entries of a given type, either positive or negative.
+	 * This is O(1) as the entries are only discarded when they are next looked up or evicted.
 	 * @param type The type of bancache entries to remove (e.g. 'G')
 	 * @param positive Remove either positive (true) or negative (false) hits.
 	 */
 	void RemoveEntries(const std::string& type, bool positive);
 
-	~BanCacheManager();
+	/** Retrieves the number of entries in the ban cache including invalidated entries which have not been discarded yet. */
+	size_t GetSize() const { return BanHash.size(); }
+
+	/** Retrieves the number of lookups which found a valid entry. */
+	unsigned long GetHits() const { return hits; }
+
+	/** Retrieves the number of lookups which did not find a valid entry. */
+	unsigned long GetMisses() const { return misses; }
+
+	/** Retrieves the number of entries which have been removed to make room for a new entry. */
+	unsigned long GetEvictions() const { return evictions; }
 };
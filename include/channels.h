@@ -44,7 +44,60 @@ class CoreExport Channel : public Extensible
 	 */
  	typedef std::map<User*, insp::aligned_storage<Membership> > MemberMap;
 
+	/** An entry in a rank ordered list of the members of a channel. */
+	struct RankedMember final
+	{
+		/** The prefix rank of the member. */
+		unsigned int rank;
+
+		/** The user who is a member of the channel. */
+		User* user;
+
+		/** The membership of the user. */
+		Membership* memb;
+	};
+
+	/** A list of the members of a channel grouped by prefix rank with the highest ranked members
+	 * first. These are stored contiguously so that messages can be fanned out to the members of
+	 * large channels without walking the nodes of the MemberMap.
+	 */
+	typedef std::vector<RankedMember> RankedMemberList;
+
+	/** The number of remote members of a channel who are on a server. */
+	struct ServerMembers final
+	{
+		/** The server which the members are on. */
+		Server* server;
+
+		/** The number of members who are on the server. */
+		size_t count;
+	};
+
+	/** A list of the servers which remote members of a channel are on. */
+	typedef std::vector<ServerMembers> ServerMemberList;
+
  private:
+	/** The local members of the channel grouped by prefix rank. */
+	RankedMemberList localmembers;
+
+	/** The remote members of the channel grouped by prefix rank. */
+	RankedMemberList remotemembers;
+
+	/** The servers which the remote members of the channel are on. */
+	ServerMemberList memberservers;
+
+	/** Retrieves the rank ordered list which a member belongs in. */
+	RankedMemberList& GetRankedList(const Membership* memb);
+
+	/** Inserts a member at the end of the group for the specified rank in its rank ordered list. */
+	void AddRanked(Membership* memb, unsigned int rank);
+
+	/** Removes a member from its rank ordered list. */
+	void DelRanked(Membership* memb);
+
+	/** Adjusts the number of members who are on the server of a remote user. */
+	void CountServerMember(User* user, bool adding);
+
 	/** Set default modes for the channel on creation
 	 */
 	void SetDefaultModes();
@@ -179,6 +232,29 @@ class CoreExport Channel : public Extensible
 	 */
 	const MemberMap& GetUsers() const { return userlist; }
 
+	/** Retrieves the local members of the channel grouped by prefix rank with the highest ranked
+	 * members first. Members which have a rank lower than the rank being looked for can be
+	 * skipped by stopping at the first one found.
+	 */
+	const RankedMemberList& GetLocalMembers() const { return localmembers; }
+
+	/** Retrieves the remote members of the channel grouped by prefix rank with the highest ranked
+	 * members first.
+	 */
+	const RankedMemberList& GetRemoteMembers() const { return remotemembers; }
+
+	/** Retrieves the servers which the remote members of the channel are on and the number of
+	 * members on each of them. This allows protocol modules to work out where to route a message
+	 * for the channel without looking at every member.
+	 */
+	const ServerMemberList& GetMemberServers() const { return memberservers; }
+
+	/** Moves a member to the right place in the rank ordered member lists after its rank changes.
+	 * This is called by the core when a prefix mode is added to or removed from a member.
+	 * @param memb The member whose rank may have changed.
+	 */
+	void UpdateRank(Membership* memb);
+
 	/** Returns true if the user given is on the given channel.
 	 * @param user The user to look for
 	 * @return True if the user is on this channel
@@ -275,6 +351,11 @@ class CoreExport Channel : public Extensible
 	 */
 	bool IsBanned(User* user);
 
+	/** Discards the cached result of checking every member against the ban list of their channels.
+	 * This must be called when something which modules may consider in OnCheckBan changes.
+	 */
+	static void InvalidateBanCache();
+
 	/** Check a single ban for match
 	 */
 	bool CheckBan(User* user, const std::string& banmask);
@@ -732,7 +732,7 @@ class CoreExport ClientProtocol::Serializer : public DataProvider
 	 * appear in the output. This is because each user may get a different set of tags for the same message.
 	 * @return Protocol message in wire format. Must contain message delimiter as well, if any (e.g. CRLF for RFC1459).
 	 */
-	virtual std::string Serialize(const Message& msg, const TagSelection& tagwl) const = 0;
+	virtual SerializedMessage Serialize(const Message& msg, const TagSelection& tagwl) const = 0;
 
 	/** Parse a protocol message from wire format.
 	 * @param user Source of the message.
@@ -740,7 +740,7 @@ class CoreExport ClientProtocol::Serializer : public DataProvider
 	 * @param parseoutput Output of the parser.
 	 * @return True if the message was parsed successfully into parseoutput and should be processed, false to drop the message.
 	 */
-	virtual bool Parse(LocalUser* user, const std::string& line, ParseOutput& parseoutput) = 0;
+	virtual bool Parse(LocalUser* user, std::string_view line, ParseOutput& parseoutput) = 0;
 };
 
 inline ClientProtocol::MessageTagData::MessageTagData(MessageTagProvider* prov, const std::string& val, void* data)
@@ -41,8 +41,16 @@ class CoreExport CommandParser
 	 * @param user The user to parse the command for.
 	 * @param command The name of the command.
 	 * @param parameters The parameters to the command.
+	 * @param length The length of the line the command was received in.
 	 */
-	void ProcessCommand(LocalUser* user, std::string& command, CommandBase::Params& parameters);
+	void ProcessCommand(LocalUser* user, std::string& command, CommandBase::Params& parameters, size_t length);
+
+	/** Records the time taken to execute a command and warns opers if it was slow.
+	 * @param user The user who executed the command.
+	 * @param handler The command which was executed.
+	 * @param latency The time taken to execute the command.
+	 */
+	void RecordLatency(LocalUser* user, Command* handler, const LatencyHistogram::Duration& latency);
 
 	/** Command list, a hash_map of command names to Command*
 	 */
@@ -117,7 +125,7 @@ class CoreExport CommandParser
 	 * @param buffer The buffer line to process
 	 * @param user The user to whom this line belongs
 	 */
-	void ProcessBuffer(LocalUser* user, const std::string& buffer);
+	void ProcessBuffer(LocalUser* user, std::string_view buffer);
 
 	/** Add a new command to the commands hash
 	 * @param f The new Command to add to the list
@@ -401,6 +401,9 @@ class CoreExport ServerConfig
 	 */
 	unsigned int SoftLimit;
 
+	/** The maximum number of entries in the ban cache. */
+	size_t BanCacheSize;
+
 	/** Maximum number of targets for a multi target command
 	 * such as PRIVMSG or KICK
 	 */
@@ -409,6 +412,15 @@ class CoreExport ServerConfig
 	/** The number of seconds that the server clock can skip by before server operators are warned. */
 	time_t TimeSkipWarn;
 
+	/** The number of milliseconds a command can take to execute before server operators are warned or 0 to never warn. */
+	unsigned long SlowCommandThreshold;
+
+	/** The number of milliseconds an iteration of the main loop can take before server operators are warned or 0 to never warn. */
+	unsigned long LoopBudget;
+
+	/** Whether the time spent in module hooks and events should be recorded. */
+	bool ProfileHooks = false;
+
 	/** True if we're going to hide ban reasons for non-opers (e.g. G-lines,
 	 * K-lines, Z-lines)
 	 */
@@ -231,6 +231,15 @@ class CoreExport Command : public CommandBase
 	/** The number of times this command has been executed. */
 	unsigned long use_count = 0;
 
+	/** The number of bytes of input which have been received for executions of this command. */
+	unsigned long long bytes_in = 0;
+
+	/** The number of bytes which have been sent back to users who have executed this command. */
+	unsigned long long bytes_out = 0;
+
+	/** The time taken to execute this command, including the time spent in module hooks. */
+	LatencyHistogram latency;
+
 	/** If non-empty then the syntax of the parameter for this command. */
 	std::vector<std::string> syntax;
 
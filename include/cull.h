@@ -91,3 +91,44 @@ class CoreExport ActionList
 	void Run();
 
 };
+
+/** Represents an action which is too expensive to perform all at once so is instead performed a
+ * step at a time over multiple iterations of the main loop.
+ */
+class CoreExport IncrementalAction
+{
+ public:
+	/** Destroys this instance of the IncrementalAction class. */
+	virtual ~IncrementalAction() = default;
+
+	/** Performs the next step of this action. This should return in a few milliseconds.
+	 * @return True if this action has more work to do; otherwise, false.
+	 */
+	virtual bool Step() = 0;
+};
+
+/** Holds the incremental actions which are currently running. The actions are not owned by
+ * this list so an action which is destroyed before it finishes must remove itself.
+ */
+class CoreExport IncrementalActionList
+{
+	std::vector<IncrementalAction*> list;
+
+ public:
+	/** Adds an action to the list if it is not already in it.
+	 * @param item The action to add.
+	 */
+	void AddAction(IncrementalAction* item);
+
+	/** Removes an action from the list.
+	 * @param item The action to remove.
+	 */
+	void DelAction(IncrementalAction* item);
+
+	/** Determines whether there are any actions in the list. */
+	bool IsEmpty() const { return list.empty(); }
+
+	/** Performs a step of every action in the list and removes the actions which have finished.
+	 */
+	void Run();
+};
@@ -205,6 +205,7 @@ inline void Events::ModuleEventProvider::Call(void (Class::*function)(FunArgs...
 		if (!mod || mod->dying)
 			continue;
 
+		HookTimer timer(mod, name);
 		Class* klass = static_cast<Class*>(subscriber);
 		(klass->*function)(std::forward<FwdArgs>(args)...);
 	}
@@ -223,6 +224,7 @@ inline ModResult Events::ModuleEventProvider::FirstResult(ModResult (Class::*fun
 		if (!mod || mod->dying)
 			continue;
 
+		HookTimer timer(mod, name);
 		Class* klass = static_cast<Class*>(subscriber);
 		result = (klass->*function)(std::forward<FwdArgs>(args)...);
 		if (result != MOD_RES_PASSTHRU)
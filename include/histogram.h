@@ -0,0 +1,89 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+/** Records the distribution of a latency in constant memory. Latencies are stored in
+ * microseconds in logarithmic buckets which are each split into linear sub-buckets so
+ * that any percentile can be retrieved with a relative error of at most 12.5%.
+ */
+class CoreExport LatencyHistogram final
+{
+ public:
+	/** The type used to represent a latency. */
+	typedef std::chrono::steady_clock::duration Duration;
+
+ private:
+	/** The number of bits of precision that each value is stored with. */
+	static constexpr unsigned int SUB_BUCKET_BITS = 3;
+
+	/** The number of linear sub-buckets within each logarithmic bucket. */
+	static constexpr unsigned int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+	/** The largest power of two (in microseconds) which can be told apart from longer latencies. */
+	static constexpr unsigned int MAX_EXPONENT = 35;
+
+	/** The total number of buckets. */
+	static constexpr unsigned int BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+	/** The number of latencies which fall within each bucket. */
+	std::array<unsigned long, BUCKETS> buckets{};
+
+	/** The number of latencies which have been recorded. */
+	unsigned long count = 0;
+
+	/** The sum of all of the latencies which have been recorded. */
+	Duration total{};
+
+	/** The longest latency which has been recorded. */
+	Duration max{};
+
+	/** Retrieves the index of the bucket that a latency falls within.
+	 * @param usecs The latency in microseconds.
+	 */
+	static unsigned int GetBucket(unsigned long long usecs);
+
+	/** Retrieves the highest latency in microseconds that falls within a bucket.
+	 * @param bucket The index of the bucket.
+	 */
+	static unsigned long long GetBucketLimit(unsigned int bucket);
+
+ public:
+	/** Records a latency.
+	 * @param latency The latency to record.
+	 */
+	void Add(Duration latency);
+
+	/** Retrieves the number of latencies which have been recorded. */
+	unsigned long GetCount() const { return count; }
+
+	/** Retrieves the longest latency which has been recorded. */
+	Duration GetMax() const { return max; }
+
+	/** Retrieves the sum of all of the latencies which have been recorded. */
+	Duration GetTotal() const { return total; }
+
+	/** Retrieves the latency which a percentage of the recorded latencies are less than or equal to.
+	 * @param percent The percentage of latencies to find the upper bound of (e.g. 99.9).
+	 * @return The upper bound of the bucket the percentile falls within (capped at the longest
+	 *         latency which was recorded) or zero if no latencies have been recorded.
+	 */
+	Duration GetPercentile(double percent) const;
+
+	/** Forgets all of the latencies which have been recorded. */
+	void Reset() { *this = LatencyHistogram(); }
+};
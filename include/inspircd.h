@@ -45,10 +45,12 @@
 #include <array>
 #include <atomic>
 #include <bitset>
+#include <chrono>
 #include <deque>
 #include <functional>
 #include <list>
 #include <memory>
+#include <optional>
 #include <map>
 #include <set>
 #include <sstream>
@@ -60,6 +62,7 @@
 
 #include "utility/aligned_storage.h"
 #include "utility/iterator_range.h"
+#include "utility/shared_buffer.h"
 #include "utility/string_view.h"
 
 #include "intrusive_list.h"
@@ -78,21 +81,24 @@ CoreExport extern InspIRCd* ServerInstance;
 #include "serialize.h"
 #include "extensible.h"
 #include "fileutils.h"
+#include "histogram.h"
 #include "ctables.h"
 #include "numerics.h"
 #include "numeric.h"
 #include "uid.h"
 #include "server.h"
+#include "timer.h"
 #include "users.h"
 #include "channels.h"
-#include "timer.h"
 #include "hashcomp.h"
+#include "wildcard.h"
 #include "logger.h"
 #include "usermanager.h"
 #include "socket.h"
 #include "command_parse.h"
 #include "mode.h"
 #include "socketengine.h"
+#include "loopprofiler.h"
 #include "snomasks.h"
 #include "filelogger.h"
 #include "message.h"
@@ -192,6 +198,10 @@ class CoreExport InspIRCd
 	 */
 	struct timespec TIME;
 
+	/** The current monotonic time in milliseconds, updated in the mainloop
+	 */
+	uint64_t MONOTONIC;
+
 	/** A 64k buffer used to read socket data into
 	 * NOTE: update ValidateNetBufferSize if you change this
 	 */
@@ -208,6 +218,8 @@ class CoreExport InspIRCd
 	CullList GlobalCulls;
 	/** Actions that must happen outside of the current call stack */
 	ActionList AtomicActions;
+	/** Actions that are performed a step at a time on each iteration of the main loop */
+	IncrementalActionList IncrementalActions;
 
 	/** Globally accessible fake user record. This is used to force mode changes etc across s2s, etc.. bit ugly, but.. better than how this was done in 1.1
 	 * Reason for it:
@@ -272,6 +284,9 @@ class CoreExport InspIRCd
 	 */
 	TimerManager Timers;
 
+	/** Measures the time spent in each phase of the main loop. */
+	LoopProfiler LoopStats;
+
 	/** X-line manager. Handles G/K/Q/E-line setting, removal and matching
 	 */
 	XLineManager* XLines = nullptr;
@@ -308,6 +323,12 @@ class CoreExport InspIRCd
 	inline time_t Time() { return TIME.tv_sec; }
 	/** The fractional time at the start of this mainloop iteration (nanoseconds) */
 	inline long Time_ns() { return TIME.tv_nsec; }
+	/** Get the monotonic time at the start of this mainloop iteration.
+	 * Unlike Time() this never goes backwards when the system clock is changed so it
+	 * should be used for measuring intervals. It is not related to the current date.
+	 * @return The number of milliseconds since an unspecified point in the past.
+	 */
+	inline uint64_t MonotonicTime() { return MONOTONIC; }
 	/** Update the current time. Don't call this unless you have reason to do so. */
 	void UpdateTime();
 
@@ -579,6 +600,63 @@ inline void Channel::Write(ClientProtocol::EventProvider& protoevprov, ClientPro
 	Write(event, status, except_list);
 }
 
+inline LoopProfiler::EventTimer::EventTimer(EventHandler* eh)
+	: start(ServerInstance->LoopStats.StartActivity())
+	, fd(eh->GetFd())
+{
+	// The handler may be deleted by the event so its type has to be read beforehand.
+	if (start != TimePoint())
+		type = GetTypeId(eh);
+}
+
+inline LoopProfiler::EventTimer::~EventTimer()
+{
+	if (start != TimePoint())
+		ServerInstance->LoopStats.AddActivity(std::chrono::steady_clock::now() - start, [this] {
+			return "socket event (" + DescribeType(type) + ")";
+		}, fd);
+}
+
+inline HookTimer::HookTimer(const Module* mod, std::string_view hookname, Implementation hookid)
+{
+	if (!ServerInstance->Config->ProfileHooks && !ServerInstance->LoopStats.IsWatching())
+		return;
+
+	previous = current;
+	current = this;
+	module = mod;
+	name = hookname;
+	hook = hookid;
+	start = std::chrono::steady_clock::now();
+}
+
+inline HookTimer::~HookTimer()
+{
+	if (!module)
+		return;
+
+	const auto elapsed = std::chrono::steady_clock::now() - start;
+	current = previous;
+	if (detached)
+		return;
+
+	ServerInstance->LoopStats.AddActivity(elapsed, [this] {
+		return module->ModuleSourceFile + " " + std::string(name);
+	});
+
+	if (!ServerInstance->Config->ProfileHooks)
+		return;
+
+	auto it = module->hookstats.find(name);
+	if (it == module->hookstats.end())
+		it = module->hookstats.emplace(name, HookStats()).first;
+
+	HookStats& stats = it->second;
+	stats.calls++;
+	stats.total += elapsed;
+	stats.max = std::max(stats.max, elapsed);
+}
+
 inline void LocalUser::Send(ClientProtocol::EventProvider& protoevprov, ClientProtocol::Message& msg)
 {
 	ClientProtocol::Event event(protoevprov, msg);
@@ -32,6 +32,7 @@
 #include "timer.h"
 
 class IOHook;
+class IOHookMiddle;
 
 /**
  * States which a socket may be in
@@ -116,12 +117,14 @@ class CoreExport StreamSocket : public EventHandler
  public:
 	/** Socket send queue
 	 */
-	class SendQueue
+	class CoreExport SendQueue
 	{
 	 public:
-		/** One element of the queue, a continuous buffer
+		/** One element of the queue, a continuous buffer. The bytes of an element are
+		 * reference counted so the same data can be queued on many sockets without
+		 * being copied.
 		 */
-		typedef std::string Element;
+		typedef insp::shared_buffer Element;
 
 		/** Sequence container of buffers in the queue
 		 */
@@ -141,11 +144,21 @@ class CoreExport StreamSocket : public EventHandler
 		 */
 		Container::size_type size() const { return data.size(); }
 
+		SendQueue() = default;
+		SendQueue(const SendQueue&) = delete;
+		SendQueue& operator=(const SendQueue&) = delete;
+		~SendQueue() { totalbytes -= nbytes; }
+
 		/** Get the number of queued bytes
 		 * @return Size in bytes of the data in the queue
 		 */
 		size_t bytes() const { return nbytes; }
 
+		/** Get the number of bytes queued in every send queue
+		 * @return Size in bytes of the data in all send queues
+		 */
+		static size_t allbytes() { return totalbytes; }
+
 		/** Get the first buffer of the queue
 		 * @return A reference to the first buffer in the queue
 		 */
@@ -168,6 +181,7 @@ class CoreExport StreamSocket : public EventHandler
 		void pop_front()
 		{
 			nbytes -= data.front().length();
+			totalbytes -= data.front().length();
 			data.pop_front();
 		}
 
@@ -177,7 +191,8 @@ class CoreExport StreamSocket : public EventHandler
 		void erase_front(Element::size_type n)
 		{
 			nbytes -= n;
-			data.front().erase(0, n);
+			totalbytes -= n;
+			data.front().remove_prefix(n);
 		}
 
 		/** Insert a new buffer at the beginning of the queue
@@ -187,6 +202,7 @@ class CoreExport StreamSocket : public EventHandler
 		{
 			data.push_front(newdata);
 			nbytes += newdata.length();
+			totalbytes += newdata.length();
 		}
 
 		/** Insert a new buffer at the end of the queue
@@ -196,6 +212,7 @@ class CoreExport StreamSocket : public EventHandler
 		{
 			data.push_back(newdata);
 			nbytes += newdata.length();
+			totalbytes += newdata.length();
 		}
 
 		/** Clear the queue
@@ -203,24 +220,40 @@ class CoreExport StreamSocket : public EventHandler
 		void clear()
 		{
 			data.clear();
+			totalbytes -= nbytes;
 			nbytes = 0;
 		}
 
 		void moveall(SendQueue& other)
 		{
 			nbytes += other.bytes();
+			totalbytes += other.bytes();
 			data.insert(data.end(), other.data.begin(), other.data.end());
 			other.clear();
 		}
 
+		/** Swap the contents of this queue with another one
+		 * @param other Queue to swap with
+		 */
+		void swap(SendQueue& other)
+		{
+			data.swap(other.data);
+			std::swap(nbytes, other.nbytes);
+		}
+
 	 private:
-	 	/** Private send queue. Note that individual strings may be shared.
+	 	/** Private send queue. Note that the bytes of individual elements may be shared
+		 * with the send queues of other sockets but are counted in full by each queue.
 		 */
 		Container data;
 
 		/** Length, in bytes, of the sendq
 		 */
 		size_t nbytes = 0;
+
+		/** Length, in bytes, of every sendq
+		 */
+		static size_t totalbytes;
 	};
 
 	/** The type of socket this IOHook represents. */
@@ -237,6 +270,9 @@ class CoreExport StreamSocket : public EventHandler
 	/** Whether the socket is currently closing or not, used to avoid repeatedly closing a closed socket */
 	bool closing = false;
 
+	/** Whether reading from the socket has been paused with PauseReading(). */
+	bool readpaused = false;
+
 	/** The IOHook that handles raw I/O for this socket, or NULL */
 	IOHook* iohook = nullptr;
 
@@ -278,10 +314,26 @@ class CoreExport StreamSocket : public EventHandler
 	 */
 	int HookChainRead(IOHook* hook, std::string& rq);
 
+	/** The size of the recvq when it was last counted towards the size of every recvq. */
+	size_t countedrecvq = 0;
+
+	/** The size of every recvq as of when each was last counted. */
+	static size_t totalrecvq;
+
  protected:
 	/** The data which has been received from the socket. */
 	std::string recvq;
 
+	/** Updates the size of every recvq after the recvq of this socket has grown or shrunk. This
+	 * is called after reading from the socket so subclasses only need to call it if they remove
+	 * data from the recvq at some other time.
+	 */
+	void CountRecvQ()
+	{
+		totalrecvq += recvq.size() - countedrecvq;
+		countedrecvq = recvq.size();
+	}
+
 	/** Swaps the internals of this StreamSocket with another one.
 	 * @param other A StreamSocket to swap internals with.
 	 */
@@ -293,10 +345,18 @@ class CoreExport StreamSocket : public EventHandler
 		: type(sstype)
 	{
 	}
+	~StreamSocket() override;
 	IOHook* GetIOHook() const;
 	void AddIOHook(IOHook* hook);
 	void DelIOHook();
 
+	/** Inserts a middle hook at the start of the hook chain so that it sees data before every
+	 * other hook attached to this socket. This is used for hooks which are negotiated after the
+	 * connection has been established such as link compression.
+	 * @param hook The hook to insert.
+	 */
+	void PushIOHook(IOHookMiddle* hook);
+
 	/** Writes the contents of the send queue to the socket. */
 	void DoWrite();
 
@@ -317,6 +377,17 @@ class CoreExport StreamSocket : public EventHandler
 	/** Retrieves the error message for this socket. */
 	const std::string& GetError() const { return error; }
 
+	/** Stops reading from this socket until ResumeReading() is called. Any data which arrives
+	 * in the meantime is left in the kernel receive buffer rather than being read into the recvq.
+	 */
+	void PauseReading();
+
+	/** Resumes reading from a socket which was paused with PauseReading(). */
+	void ResumeReading();
+
+	/** Determines whether reading from this socket has been paused. */
+	bool IsReadingPaused() const { return readpaused; }
+
 	/** Called when new data is present in the receive queue. */
 	virtual void OnDataReady() = 0;
 
@@ -337,7 +408,7 @@ class CoreExport StreamSocket : public EventHandler
 
 	/** Send the given data out the socket, either now or when writes unblock
 	 */
-	void WriteData(const std::string& data);
+	void WriteData(const SendQueue::Element& data);
 
 	/** Retrieves the current size of the send queue. */
 	size_t GetSendQSize() const;
@@ -345,6 +416,9 @@ class CoreExport StreamSocket : public EventHandler
 	/** Retrieves the send queue. */
 	SendQueue& GetSendQ() { return sendq; }
 
+	/** Retrieves the size of the receive queues of every socket as of when they were last read from. */
+	static size_t GetTotalRecvQSize() { return totalrecvq; }
+
 	/**
 	 * Close the socket, remove from socket engine, etc
 	 */
@@ -50,6 +50,21 @@ CoreExport std::string BinToBase64(const std::string& data, const char* table =
 /** Base64 decode */
 CoreExport std::string Base64ToBin(const std::string& data, const char* table = NULL);
 
+/** Finds the first carriage return or null character in a buffer. On x86 this examines 16 or
+ * 32 bytes at a time depending on what the CPU supports.
+ * @param data The buffer to search.
+ * @param len The length of the buffer.
+ * @return The position of the first carriage return or null character or len if there is none.
+ */
+CoreExport size_t FindLineControl(const char* data, size_t len);
+
+/** Removes carriage returns from and replaces null characters with spaces in a buffer.
+ * @param data The buffer to clean up in place.
+ * @param len The length of the buffer.
+ * @return The length of the buffer after it has been cleaned up.
+ */
+CoreExport size_t CleanLine(char* data, size_t len);
+
 /** Compose a hex string from the data in a std::string.
  * @param data The data to compose hex from
  * @return The hex string.
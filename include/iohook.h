@@ -66,6 +66,12 @@ class IOHookProvider : public refcountbase, public ServiceProvider
 
 class IOHook : public Cullable
 {
+ protected:
+	/** Whether the kernel is handling outgoing data for this hook. If set the hooked socket
+	 * writes its send queue directly and OnStreamSocketWrite is no longer called.
+	 */
+	bool kernelsend = false;
+
  public:
 	/** The IOHookProvider for this hook, contains information about the hook,
 	 * such as the module providing it and the hook type.
@@ -78,6 +84,9 @@ class IOHook : public Cullable
 	IOHook(IOHookProvider* provider)
 		: prov(provider) { }
 
+	/** Determines whether the kernel is handling outgoing data for this hook. */
+	bool IsKernelSend() const { return kernelsend; }
+
 	/**
 	 * Called when the hooked socket has data to write, or when the socket engine returns it as writable
 	 * @param sock Hooked socket
@@ -41,6 +41,27 @@ class CoreExport ListModeBase : public ModeHandler
 	 */
 	typedef std::vector<ListItem> ModeList;
 
+	/** The items in a channel's list grouped by the form of their mask. This allows the items
+	 * which could match a user to be found without checking every item in the list.
+	 */
+	struct MaskIndex final
+	{
+		/** Items which are not a nick!user\@host mask such as extbans. */
+		std::vector<const ListItem*> other;
+
+		/** Items with a literal host part keyed by that host. */
+		std::unordered_map<std::string, std::vector<const ListItem*>, irc::insensitive, irc::StrHashComp> exact;
+
+		/** Items with a CIDR range as their host part. */
+		std::vector<const ListItem*> cidr;
+
+		/** Items with a glob pattern as their host part. */
+		std::vector<const ListItem*> wildcard;
+
+		/** A number which changes whenever the list is modified. This is never zero. */
+		unsigned long generation = 0;
+	};
+
  private:
 	class ChanData
 	{
@@ -48,7 +69,19 @@ class CoreExport ListModeBase : public ModeHandler
 		ModeList list;
 		int maxitems;
 
+		/** The index of the items in list. Only valid if indexmap is the current national case map. */
+		MaskIndex index;
+
+		/** The national case map that index was built with or nullptr if it needs to be rebuilt. */
+		const unsigned char* indexmap = nullptr;
+
 		ChanData() : maxitems(-1) { }
+
+		/** Marks the index as needing to be rebuilt after the list has been modified. */
+		void Changed();
+
+		/** Rebuilds the index from the list. */
+		void RebuildIndex();
 	};
 
 	/** The number of items a listmode's list may contain
@@ -141,6 +174,13 @@ class CoreExport ListModeBase : public ModeHandler
 	 */
 	ModeList* GetList(Channel* channel);
 
+	/** Retrieves an index of the items of this mode which are set on the given channel.
+	 * The index is rebuilt if the list has been modified since it was last retrieved.
+	 * @param channel Channel to get the index for
+	 * @return The index of the list on the given channel, can be NULL
+	 */
+	const MaskIndex* GetIndex(Channel* channel);
+
 	/** Display the list for this mode
 	 * See mode.h
 	 * @param user The user to send the list to
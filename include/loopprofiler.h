@@ -0,0 +1,219 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+/** Measures how long each phase of the main loop takes. If an iteration of the main loop
+ * takes longer than <performance:loopbudget> then it is reported along with the slowest
+ * socket events, timers, commands and module hooks which ran during it.
+ */
+class CoreExport LoopProfiler final
+{
+ public:
+	/** The phases of an iteration of the main loop. */
+	enum Phase
+	{
+		/** Running timers and the background tasks which happen once a second. */
+		PHASE_TIMERS,
+
+		/** Waiting for socket events. This is not counted towards the loop budget. */
+		PHASE_WAIT,
+
+		/** Dispatching socket events. */
+		PHASE_DISPATCH,
+
+		/** Deleting objects which have been culled. */
+		PHASE_CULL,
+
+		/** Running atomic and incremental actions. */
+		PHASE_ACTIONS,
+
+		/** The number of phases. Also used for the total time spent not waiting. */
+		PHASE_COUNT
+	};
+
+	typedef LatencyHistogram::Duration Duration;
+	typedef std::chrono::steady_clock::time_point TimePoint;
+
+	/** Identifies the dynamic type of an object. This is cheap to obtain for every activity and is
+	 * only turned into a name by DescribeType() if the activity is reported.
+	 */
+	typedef const void* TypeId;
+
+	/** Something which took a long time during an iteration of the main loop. */
+	struct Activity final
+	{
+		/** The phase in which the activity happened. */
+		Phase phase;
+
+		/** The time which the activity took. */
+		Duration time;
+
+		/** A description of the activity. */
+		std::string name;
+
+		/** If the activity was a socket event then the file descriptor of the socket; otherwise, -1. */
+		int fd;
+	};
+
+	/** Times a socket event if the loop watchdog is enabled. */
+	class CoreExport EventTimer final
+	{
+	 private:
+		/** The time at which the event started or the epoch if the watchdog is disabled. */
+		TimePoint start;
+
+		/** The file descriptor of the socket the event is for. */
+		int fd;
+
+		/** The type of the handler the event is for. */
+		TypeId type = nullptr;
+
+	 public:
+		inline EventTimer(EventHandler* eh);
+		inline ~EventTimer();
+	};
+
+	/** The length of the window that the loop statistics are summarised over. */
+	static constexpr std::chrono::seconds WINDOW = std::chrono::seconds(60);
+
+ private:
+	/** The maximum number of activities to report for a slow iteration. */
+	static constexpr size_t MAX_ACTIVITIES = 8;
+
+	/** The time which an iteration may take before it is reported or zero if the watchdog is disabled. */
+	Duration budget{};
+
+	/** The phase which is currently running or PHASE_COUNT if none is. */
+	Phase phase = PHASE_COUNT;
+
+	/** The time at which the current phase started. */
+	TimePoint phasestart;
+
+	/** The time spent in each phase during the current iteration. */
+	std::array<Duration, PHASE_COUNT> phasetimes{};
+
+	/** The slowest activities during the current iteration ordered from slowest to fastest. */
+	std::vector<Activity> activities;
+
+	/** The time spent in each phase, and in total excluding waiting, during the current window. */
+	std::array<LatencyHistogram, PHASE_COUNT + 1> window;
+
+	/** The time spent in each phase, and in total excluding waiting, during the previous window. */
+	std::array<LatencyHistogram, PHASE_COUNT + 1> lastwindow;
+
+	/** The time at which the current window started. */
+	TimePoint windowstart = std::chrono::steady_clock::now();
+
+	/** The number of iterations which have taken longer than the budget. */
+	unsigned long stalls = 0;
+
+	/** Reports an iteration which took longer than the budget.
+	 * @param busy The time spent in the iteration excluding waiting for socket events.
+	 */
+	void ReportStall(const Duration& busy);
+
+ public:
+	/** Retrieves an identifier for the dynamic type of an object. This must be called before the
+	 * object has a chance to delete itself.
+	 * @param obj The object to identify.
+	 */
+	template <typename T>
+	static TypeId GetTypeId(const T* obj)
+	{
+		static_assert(std::is_polymorphic_v<T>);
+#ifdef INSPIRCD_ENABLE_RTTI
+		return &typeid(*obj);
+#else
+		// Without RTTI the address of the vtable is the only thing which identifies the type.
+		return *reinterpret_cast<const void* const*>(obj);
+#endif
+	}
+
+	/** Describes the type of an object as the name of its class and the file it was loaded from.
+	 * @param type An identifier returned by GetTypeId().
+	 */
+	static std::string DescribeType(TypeId type);
+
+	/** Retrieves the name of a phase.
+	 * @param phase The phase to retrieve the name of. PHASE_COUNT is the total time excluding waiting.
+	 */
+	static const char* GetPhaseName(Phase phase);
+
+	/** Determines whether the loop watchdog is enabled. */
+	bool IsWatching() const { return budget != Duration::zero(); }
+
+	/** Starts a phase of the current iteration and ends the one which was running.
+	 * @param newphase The phase to start.
+	 */
+	void StartPhase(Phase newphase);
+
+	/** Ends the current iteration, records its phase times and reports it if it was too slow. */
+	void EndIteration();
+
+	/** Retrieves the time at which an activity started or the epoch if the watchdog is disabled. */
+	TimePoint StartActivity() const
+	{
+		return IsWatching() ? std::chrono::steady_clock::now() : TimePoint();
+	}
+
+	/** Records an activity which happened during the current phase.
+	 * @param time The time which the activity took.
+	 * @param describe A function which returns a description of the activity. This is only
+	 *                 called if the activity is one of the slowest in the current iteration.
+	 * @param fd If the activity was a socket event then the file descriptor of the socket.
+	 */
+	template <typename Describe>
+	void AddActivity(const Duration& time, Describe&& describe, int fd = -1)
+	{
+		// Activities which are too short to contribute to a stall are not worth describing.
+		if (!IsWatching() || time < budget / 100)
+			return;
+
+		if (activities.size() >= MAX_ACTIVITIES && time <= activities.back().time)
+			return;
+
+		auto it = std::find_if(activities.begin(), activities.end(), [&time](const Activity& activity) {
+			return activity.time < time;
+		});
+		activities.insert(it, { phase, time, describe(), fd });
+		if (activities.size() > MAX_ACTIVITIES)
+			activities.pop_back();
+	}
+
+	/** Records an activity which started at the specified time.
+	 * @param start The time returned by StartActivity() when the activity started.
+	 * @param describe A function which returns a description of the activity.
+	 */
+	template <typename Describe>
+	void EndActivity(const TimePoint& start, Describe&& describe)
+	{
+		if (start != TimePoint())
+			AddActivity(std::chrono::steady_clock::now() - start, describe);
+	}
+
+	/** Retrieves the number of iterations which have taken longer than the budget. */
+	unsigned long GetStalls() const { return stalls; }
+
+	/** Retrieves the phase times for the most recent complete window or, if there has not been one
+	 * yet, for the current window.
+	 */
+	const std::array<LatencyHistogram, PHASE_COUNT + 1>& GetWindow() const
+	{
+		return lastwindow[PHASE_COUNT].GetCount() ? lastwindow : window;
+	}
+};
@@ -57,6 +57,25 @@ class CoreExport Membership : public Extensible, public insp::intrusive_list_nod
 	 */
 	Id id;
 
+	/** The ban list generation that banned was computed for or 0 if it has not been computed.
+	 * This is managed by Channel::IsBanned().
+	 */
+	unsigned long banlistgen = 0;
+
+	/** The value of the ban cache epoch that banned was computed in. */
+	unsigned long banepoch = 0;
+
+	/** The mask generation of the user that banned was computed for. */
+	unsigned long banmaskgen = 0;
+
+	/** Whether the user matched one of the nick!user\@host entries in the ban list. */
+	bool banned = false;
+
+	/** The position of this member in the rank ordered member list of the channel. This is
+	 * managed by the Channel and should not be modified by anything else.
+	 */
+	size_t rankpos = 0;
+
 	/** Converts a string to a Membership::Id
 	 * @param str The string to convert
 	 * @return Raw value of type Membership::Id
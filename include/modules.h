@@ -138,7 +138,10 @@ class ModResult
 		try \
 		{ \
 			if (!(*_i)->dying) \
+			{ \
+				HookTimer _timer(*_i, #y, I_ ## y); \
 				(*_i)->y x ; \
+			} \
 		} \
 		catch (CoreException& modexcept) \
 		{ \
@@ -162,7 +165,10 @@ do { \
 		try \
 		{ \
 			if (!(*_i)->dying) \
-				v = (*_i)->n args;
+			{ \
+				HookTimer _timer(*_i, #n, I_ ## n); \
+				v = (*_i)->n args; \
+			}
 
 #define WHILE_EACH_HOOK(n) \
 		} \
@@ -227,6 +233,7 @@ enum Implementation
 	I_OnDelLine,
 	I_OnExpireLine,
 	I_OnGarbageCollect,
+	I_OnGetBanHosts,
 	I_OnKill,
 	I_OnLoadModule,
 	I_OnMode,
@@ -278,6 +285,66 @@ enum Implementation
 	I_END
 };
 
+/** Holds the latency statistics of a module hook which were collected while hook profiling was enabled. */
+struct HookStats final
+{
+	/** The number of times the hook has been called. */
+	unsigned long long calls = 0;
+
+	/** The total time which has been spent in the hook. */
+	std::chrono::steady_clock::duration total{};
+
+	/** The longest time which has been spent in a single call to the hook. */
+	std::chrono::steady_clock::duration max{};
+};
+
+/** Measures the time taken by a call to a module hook or event and adds it to the latency
+ * statistics of the module and the loop watchdog. When hook profiling and the loop watchdog
+ * are both disabled this does nothing.
+ */
+class CoreExport HookTimer final
+{
+ private:
+	/** The innermost call which is currently being timed. */
+	static HookTimer* current;
+
+	/** The call which was being timed when this call started. */
+	HookTimer* previous;
+
+	/** The module which is being called or nullptr if the call is not being timed. */
+	const Module* module = nullptr;
+
+	/** The name of the hook or event which is being called. */
+	std::string_view name;
+
+	/** The hook which is being called or I_END if an event is being called. */
+	Implementation hook;
+
+	/** Whether the module detached itself from the hook during the call. */
+	bool detached = false;
+
+	/** The time at which the call started. */
+	std::chrono::steady_clock::time_point start;
+
+ public:
+	/** Starts timing a call to a module hook or event.
+	 * @param mod The module which is being called.
+	 * @param hookname The name of the hook or event which is being called.
+	 * @param hookid The hook which is being called or I_END if an event is being called.
+	 */
+	inline HookTimer(const Module* mod, std::string_view hookname, Implementation hookid = I_END);
+
+	/** Stops timing the call and records the time it took. */
+	inline ~HookTimer();
+
+	/** Called when a module detaches itself from a hook. If this happens from within the default
+	 * implementation of the hook the call is not recorded as the module does not handle the hook.
+	 * @param mod The module which detached from the hook.
+	 * @param hookid The hook which the module detached from.
+	 */
+	static void OnDetach(const Module* mod, Implementation hookid);
+};
+
 /** Base class for all InspIRCd modules
  *  This class is the base class for InspIRCd modules. All modules must inherit from this class,
  *  its methods will be called when irc server events occur. class inherited from module must be
@@ -320,6 +387,11 @@ class CoreExport Module : public Cullable, public usecountbase
 	/** The properties of this module. */
 	const int properties;
 
+	/** The latency statistics of the hooks and events of this module keyed by their name. This
+	 * is only populated when <performance:profilehooks> is enabled.
+	 */
+	mutable std::map<std::string, HookStats, std::less<>> hookstats;
+
 	/** Module setup
 	 * \exception ModuleException Throwing this class, or any class derived from ModuleException, causes loading of the module to abort.
 	 */
@@ -887,6 +959,15 @@ class CoreExport Module : public Cullable, public usecountbase
 	 */
 	virtual ModResult OnCheckBan(User* user, Channel* chan, const std::string& mask);
 
+	/** Called to retrieve the hosts other than the real host, displayed host and IP address of a user
+	 * which this module matches nick!user\@host bans against in OnCheckBan. Modules which match bans
+	 * against other hosts should implement this so that bans with a literal host can be looked up by
+	 * host rather than every one of them being checked against the user.
+	 * @param user The user to retrieve the hosts of
+	 * @param hosts The list to add the hosts to
+	 */
+	virtual void OnGetBanHosts(User* user, std::vector<std::string>& hosts);
+
 	/** Called whenever a change of a local users displayed host is attempted.
 	 * Return 1 to deny the host change, or 0 to allow it.
 	 * @param user The user whos host will be changed
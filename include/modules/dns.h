@@ -161,6 +161,15 @@ namespace DNS
 		virtual void RemoveRequest(Request* req) = 0;
 		virtual std::string GetErrorStr(Error) = 0;
 		virtual std::string GetTypeStr(QueryType) = 0;
+
+		/** Retrieves the number of results which are currently cached. */
+		virtual size_t GetCacheSize() const = 0;
+
+		/** Retrieves the number of requests which have been answered from the cache. */
+		virtual unsigned long GetCacheHits() const = 0;
+
+		/** Retrieves the number of requests which could not be answered from the cache. */
+		virtual unsigned long GetCacheMisses() const = 0;
 	};
 
 	/** A DNS query.
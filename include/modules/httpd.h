@@ -239,6 +239,23 @@ class HTTPRequest
 	}
 };
 
+/** Generates the document of a HTTP response a piece at a time. This allows documents which are
+ * too large to build all at once to be sent over several iterations of the main loop without
+ * holding the whole document in memory.
+ */
+class HTTPDocumentStream
+{
+ public:
+	virtual ~HTTPDocumentStream() = default;
+
+	/** Writes the next piece of the document. Each piece should be small enough to generate
+	 * in well under a millisecond.
+	 * @param data The stream to write the piece to.
+	 * @return True if there is more of the document to write; otherwise, false.
+	 */
+	virtual bool Generate(std::ostream& data) = 0;
+};
+
 /** If you want to reply to HTTP requests, you must return a HTTPDocumentResponse to
  * the httpd module via the HTTPdAPI.
  * When you initialize this class you initialize it with all components required to
@@ -253,6 +270,12 @@ class HTTPDocumentResponse
 	Module* const module;
 
 	std::stringstream* document;
+
+	/** If non-NULL then the document is generated by this stream instead. The httpd module
+	 * takes ownership of the stream when the response is sent.
+	 */
+	HTTPDocumentStream* stream = nullptr;
+
 	unsigned int responsecode;
 
 	/** Any extra headers to include with the defaults
@@ -272,6 +295,18 @@ class HTTPDocumentResponse
 		: module(mod), document(doc), responsecode(response), src(req)
 	{
 	}
+
+	/** Initialize a HTTPDocumentResponse whose document is generated as it is sent.
+	 * @param mod A pointer to the module who responded to the request
+	 * @param req The request you obtained from the HTTPRequest at an earlier time
+	 * @param str The stream which generates the document body. This must be allocated with new.
+	 * @param response A valid HTTP/1.0 or HTTP/1.1 response code. The response text will be determined for you
+	 * based upon the response code.
+	 */
+	HTTPDocumentResponse(Module* mod, HTTPRequest& req, HTTPDocumentStream* str, unsigned int response)
+		: module(mod), document(nullptr), stream(str), responsecode(response), src(req)
+	{
+	}
 };
 
 class HTTPdAPIBase : public DataProvider
@@ -34,6 +34,10 @@ namespace ReloadModule
 		{
 			EventListener* handler;
 			void* data;
+
+			/** Whether the handler belongs to the module being reloaded. */
+			bool ownmodule = false;
+
 			Data(EventListener* Handler, void* moddata) : handler(Handler), data(moddata) { }
 		};
 		typedef std::vector<Data> List;
@@ -42,7 +46,9 @@ namespace ReloadModule
 	 public:
 		/** Add data to the saved state of a module.
 		 * The provided handler's OnReloadModuleRestore() method will be called when the reload is done with the pointer
-		 * provided.
+		 * provided. If the handler belongs to the module being reloaded the data is passed to the handler of the new
+		 * instance of the module instead and must be a std::string allocated with new as the layout of any other type
+		 * may differ between the two instances.
 		 * @param handler Handler for restoring the data
 		 * @param data Pointer to the data, will be passed back to the provided handler's OnReloadModuleRestore() after the
 		 * reload finishes
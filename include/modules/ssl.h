@@ -191,7 +191,7 @@ class SSLIOHook : public IOHook
 			sendq.pop_front();
 		}
 		while (!sendq.empty() && tmp.length() < targetsize);
-		sendq.push_front(tmp);
+		sendq.push_front(std::move(tmp));
 	}
 
  public:
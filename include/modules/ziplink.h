@@ -0,0 +1,132 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include "iohook.h"
+
+namespace ZipLink
+{
+	class Hook;
+	class Provider;
+
+	/** The prefix of the names of all link compression providers. */
+	inline const std::string PREFIX = "ziplink/";
+}
+
+/** Base class for I/O hooks which compress the data sent over a server link. A hook is
+ * inserted at the start of the hook chain of a socket so that it compresses data before
+ * any TLS hook encrypts it. Data is passed through unchanged in each direction until the
+ * link protocol module starts compressing or decompressing it.
+ */
+class ZipLink::Hook : public IOHookMiddle
+{
+ protected:
+	/** Whether data written to the socket is being compressed. */
+	bool compressing = false;
+
+	/** Whether data read from the socket is being decompressed. */
+	bool decompressing = false;
+
+ public:
+	/** The number of bytes which have been given to the hook to compress. */
+	unsigned long long rawout = 0;
+
+	/** The number of compressed bytes which the hook has sent. */
+	unsigned long long zipout = 0;
+
+	/** The number of compressed bytes which the hook has received. */
+	unsigned long long zipin = 0;
+
+	/** The number of bytes which the hook has decompressed the received data to. */
+	unsigned long long rawin = 0;
+
+	/** The time which has been spent compressing data. */
+	std::chrono::steady_clock::duration ziptime{};
+
+	/** The time which has been spent decompressing data. */
+	std::chrono::steady_clock::duration unziptime{};
+
+	Hook(IOHookProvider* provider)
+		: IOHookMiddle(provider)
+	{
+	}
+
+	/** Retrieves the name of the compression method used by this hook. */
+	std::string GetMethod() const { return prov->name.substr(PREFIX.length()); }
+
+	/** Determines whether data written to the socket is being compressed. */
+	bool IsCompressing() const { return compressing; }
+
+	/** Determines whether data read from the socket is being decompressed. */
+	bool IsDecompressing() const { return decompressing; }
+
+	/** Starts compressing data written to the socket. Any data which has already been passed
+	 * through the hook is sent uncompressed.
+	 */
+	void StartCompression() { compressing = true; }
+
+	/** Starts decompressing data read from the socket.
+	 * @param recvq Data which the socket has already read past the point at which the remote
+	 *              server started compressing. This is replaced with the decompressed data.
+	 * @return True if the data was decompressed; otherwise, false.
+	 */
+	virtual bool StartDecompression(std::string& recvq) = 0;
+
+	/** Finds the compression hook attached to a socket.
+	 * @param sock The socket to find the compression hook of.
+	 * @return The compression hook of the socket or nullptr if it does not have one.
+	 */
+	static Hook* Find(StreamSocket* sock)
+	{
+		for (IOHook* hook = sock->GetIOHook(); hook; )
+		{
+			if (!hook->prov->name.compare(0, PREFIX.length(), PREFIX))
+				return static_cast<Hook*>(hook);
+
+			IOHookMiddle* middlehook = IOHookMiddle::ToMiddleHook(hook);
+			hook = middlehook ? middlehook->GetNextHook() : nullptr;
+		}
+		return nullptr;
+	}
+};
+
+/** Base class for providers of link compression methods. Compression is negotiated by the
+ * link protocol module after a connection has been established so these hooks can not be
+ * attached to listeners or outgoing connections.
+ */
+class ZipLink::Provider : public IOHookProvider
+{
+ public:
+	/** Initializes a new link compression provider.
+	 * @param mod The module which provides the compression method.
+	 * @param method The name of the compression method.
+	 */
+	Provider(Module* mod, const std::string& method)
+		: IOHookProvider(mod, PREFIX + method, IOHookProvider::IOH_UNKNOWN, true)
+	{
+	}
+
+	/** Creates a compression hook and inserts it at the start of the hook chain of a socket.
+	 * @param sock The socket to compress the data of.
+	 * @return The hook which was attached to the socket.
+	 */
+	virtual Hook* Create(StreamSocket* sock) = 0;
+
+	void OnAccept(StreamSocket* sock, irc::sockets::sockaddrs* client, irc::sockets::sockaddrs* server) override { }
+	void OnConnect(StreamSocket* sock) override { }
+};
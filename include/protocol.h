@@ -50,6 +50,12 @@ class CoreExport ProtocolInterface
 		unsigned int usercount;
 		unsigned int opercount;
 		unsigned int latencyms;
+
+		/** If the server is directly linked to this one then the number of bytes received from it. */
+		unsigned long long bytesin = 0;
+
+		/** If the server is directly linked to this one then the number of bytes sent to it. */
+		unsigned long long bytesout = 0;
 	};
 
 	typedef std::vector<ServerInfo> ServerList;
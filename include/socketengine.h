@@ -261,6 +261,20 @@ class CoreExport SocketEngine
 		unsigned long ReadEvents = 0;
 		unsigned long WriteEvents = 0;
 		unsigned long ErrorEvents = 0;
+
+		/** The number of bytes which have been received since the server started. */
+		unsigned long long BytesIn = 0;
+
+		/** The number of bytes which have been sent since the server started. */
+		unsigned long long BytesOut = 0;
+
+		/** The number of system calls made to update the interest set of the socket engine. */
+		unsigned long ChangeCalls = 0;
+
+		/** The number of interest changes which were merged into another pending change or
+		 * cancelled out before they needed to be applied.
+		 */
+		unsigned long ChangesCoalesced = 0;
 	};
 
  private:
@@ -390,9 +404,10 @@ public:
 	 * number of events which occurred during this call.  This method will
 	 * dispatch events to their handlers by calling their
 	 * EventHandler::OnEventHandler*() methods.
+	 * @param timeout The maximum number of milliseconds to wait for an event.
 	 * @return The number of events which have occurred.
 	 */
-	static int DispatchEvents();
+	static int DispatchEvents(int timeout = 1000);
 
 	/** Dispatch trial reads and writes. This causes the actual socket I/O
 	 * to happen when writes have been pre-buffered.
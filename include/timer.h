@@ -28,10 +28,10 @@
 
 class Module;
 
-/** Timer class for one-second resolution timers
+/** Timer class for millisecond resolution timers
  * Timer provides a facility which allows module
  * developers to create one-shot timers. The timer
- * can be made to trigger at any time up to a one-second
+ * can be made to trigger at any time up to a one-millisecond
  * resolution. To use Timer, inherit a class from
  * Timer, then insert your inherited class into the
  * queue using Server::AddTimer(). The Tick() method of
@@ -39,19 +39,39 @@ class Module;
  * at the given time.
  */
 class CoreExport Timer
+	: public insp::intrusive_list_node<Timer>
 {
+	friend class TimerManager;
+
 	/** The triggering time
 	 */
 	time_t trigger;
 
-	/** Number of seconds between triggers
+	/** The monotonic time in milliseconds at which the timer manager will tick this timer.
+	 */
+	uint64_t expiry;
+
+	/** The timer wheel slot this timer is in or nullptr if it is not scheduled.
+	 */
+	insp::intrusive_list_tail<Timer>* slot = nullptr;
+
+	/** The level of the timer wheel which slot is on. Only valid if slot is a wheel slot.
 	 */
-	unsigned int secs;
+	size_t level = 0;
+
+	/** The time between triggers
+	 */
+	std::chrono::milliseconds interval;
 
 	/** True if this is a repeating timer
 	 */
 	bool repeat;
 
+	/** Sets the trigger and expiry times to the specified time from now.
+	 * @param delay The time from now to trigger the timer at.
+	 */
+	void SetTriggerFromNow(std::chrono::milliseconds delay);
+
  public:
 	/** Default constructor, initializes the triggering time
 	 * @param secs_from_now The number of seconds from now to trigger the timer
@@ -59,6 +79,12 @@ class CoreExport Timer
 	 */
 	Timer(unsigned int secs_from_now, bool repeating = false);
 
+	/** Initializes the triggering time with millisecond precision
+	 * @param from_now The time from now to trigger the timer
+	 * @param repeating Repeat this timer every from_now if set to true
+	 */
+	Timer(std::chrono::milliseconds from_now, bool repeating = false);
+
 	/** Default destructor, removes the timer from the timer manager
 	 */
 	virtual ~Timer();
@@ -74,15 +100,16 @@ class CoreExport Timer
 	 * This does not update the bookkeeping in TimerManager, use SetInterval()
 	 * to change the interval between ticks while keeping TimerManager updated
 	 */
-	void SetTrigger(time_t nexttrigger)
-	{
-		trigger = nexttrigger;
-	}
+	void SetTrigger(time_t nexttrigger);
 
 	/** Sets the interval between two ticks.
 	 */
 	void SetInterval(unsigned int interval);
 
+	/** Sets the interval between two ticks with millisecond precision.
+	 */
+	void SetInterval(std::chrono::milliseconds newinterval);
+
 	/** Called when the timer ticks.
 	 * You should override this method with some useful code to
 	 * handle the tick event.
@@ -103,7 +130,14 @@ class CoreExport Timer
 	 */
 	unsigned int GetInterval() const
 	{
-		return secs;
+		return std::chrono::duration_cast<std::chrono::seconds>(interval).count();
+	}
+
+	/** Returns the interval between ticks of this timer object with millisecond precision.
+	 */
+	std::chrono::milliseconds GetIntervalMs() const
+	{
+		return interval;
 	}
 
 	/** Cancels the repeat state of a repeating timer.
@@ -119,14 +153,60 @@ class CoreExport Timer
 /** This class manages sets of Timers, and triggers them at their defined times.
  * This will ensure timers are not missed, as well as removing timers that have
  * expired and allowing the addition of new ones.
+ *
+ * Timers are kept in a hierarchical timing wheel with a resolution of one
+ * millisecond. Each level of the wheel has a number of slots which each cover
+ * a range of expiry times which is a multiple of the range covered by a slot on
+ * the level below it. When the lower level wraps around the timers in the next
+ * slot of the upper level are moved down. Adding and removing a timer therefore
+ * takes constant time regardless of how many timers exist.
  */
-class CoreExport TimerManager
+class CoreExport TimerManager final
 {
-	typedef std::multimap<time_t, Timer*> TimerMap;
+ private:
+	/** The number of bits of the expiry time which select a slot on each level. */
+	static constexpr unsigned int SLOT_BITS = 6;
 
-	/** A list of all pending timers
+	/** The number of slots on each level of the wheel. */
+	static constexpr size_t SLOT_COUNT = 1 << SLOT_BITS;
+
+	/** The number of levels in the wheel. This allows timers of up to 2^30
+	 * milliseconds (about twelve days) to be scheduled directly. Timers which
+	 * expire further in the future are placed in the last slot which can hold
+	 * them and are moved to the correct slot when it is reached.
 	 */
-	TimerMap Timers;
+	static constexpr size_t LEVEL_COUNT = 5;
+
+	/** A list of timers which expire within the range of a slot. */
+	typedef insp::intrusive_list_tail<Timer> TimerList;
+
+	/** The slots of the wheel. */
+	TimerList wheel[LEVEL_COUNT][SLOT_COUNT];
+
+	/** The number of timers on each level of the wheel. */
+	size_t levelsizes[LEVEL_COUNT] = { };
+
+	/** Timers which have been taken off the wheel to be ticked. */
+	TimerList expired;
+
+	/** The next millisecond which has not been processed yet. */
+	uint64_t current = 0;
+
+	/** Inserts a timer into the slot that covers its expiry time.
+	 * @param t The timer to insert.
+	 */
+	void Schedule(Timer* t);
+
+	/** Removes a timer from the slot it is in.
+	 * @param t The timer to remove.
+	 */
+	void Unschedule(Timer* t);
+
+	/** Moves the timers in a slot of an upper level to the levels below it.
+	 * @param level The level of the slot.
+	 * @param index The index of the slot within the level.
+	 */
+	void Cascade(size_t level, size_t index);
 
  public:
 	/** Tick all pending Timers
@@ -134,7 +214,14 @@ class CoreExport TimerManager
 	 */
 	void TickTimers(time_t TIME);
 
-	/** Add an Timer
+	/** Retrieves the number of milliseconds until a timer might need to be ticked.
+	 * This may be earlier than the next timer expires if timers need to be moved
+	 * between the levels of the wheel before then.
+	 * @param maxwait The maximum number of milliseconds to return.
+	 */
+	int GetNextTimeout(int maxwait) const;
+
+	/** Add an Timer. If the timer has already been added then it is rescheduled.
 	 * @param T an Timer derived class to add
 	 */
 	void AddTimer(Timer *T);
@@ -63,7 +63,7 @@ namespace ClientProtocol
 
 	typedef std::vector<Message*> MessageList;
 	typedef std::vector<std::string> ParamList;
-	typedef std::string SerializedMessage;
+	typedef insp::shared_buffer SerializedMessage;
 
 	struct MessageTagData
 	{
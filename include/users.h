@@ -257,6 +257,9 @@ class CoreExport User : public Extensible
 	 */
 	std::string cachedip;
 
+	/** Incremented by InvalidateCache() whenever the masks of this user change. */
+	unsigned long maskgeneration = 0;
+
 	/** If set then the hostname which is displayed to users. */
 	std::string displayhost;
 
@@ -435,6 +438,11 @@ class CoreExport User : public Extensible
 	 */
 	void InvalidateCache();
 
+	/** Retrieves a number which changes whenever the nick, ident, hostnames or IP address of this
+	 * user changes. This can be used to tell when a cached check against the user's masks is stale.
+	 */
+	unsigned long GetMaskGeneration() const { return maskgeneration; }
+
 	/** Returns whether this user is currently away or not. If true,
 	 * further information can be found in User::awaymsg and User::awaytime
 	 * @return True if the user is away, false otherwise
@@ -632,16 +640,29 @@ class CoreExport User : public Extensible
 class CoreExport UserIOHandler : public StreamSocket
 {
  private:
-	 size_t checked_until;
+	/** The position within the recvq up to which has been searched for an EOL. */
+	size_t checked_until = 0;
+
+	/** The position within the recvq at which the next unprocessed line starts. */
+	size_t recvq_start = 0;
+
+	/** Removes lines which have already been processed from the start of the recvq. */
+	void CompactRecvQ();
+
+	/** Checks whether the user has exceeded the maximum size of their recvq and quits them if they have.
+	 * @return True if the user is within their recvq limit; otherwise, false.
+	 */
+	bool CheckRecvQ();
+
  public:
 	LocalUser* const user;
 	UserIOHandler(LocalUser* me)
 		: StreamSocket(StreamSocket::SS_USER)
-		, checked_until(0)
 		, user(me)
 	{
 	}
 	void OnDataReady() override;
+	void OnEventHandlerWrite() override;
 	bool OnSetLocalEndPoint(const irc::sockets::sockaddrs& ep) override;
 	bool OnSetRemoteEndPoint(const irc::sockets::sockaddrs& ep) override;
 	void OnError(BufferedSocketError error) override;
@@ -651,7 +672,7 @@ class CoreExport UserIOHandler : public StreamSocket
 	 * sendq value, the user will be removed, and further buffer adds will be dropped.
 	 * @param data The data to add to the write buffer
 	 */
-	void AddWriteBuf(const std::string &data);
+	void AddWriteBuf(const SendQueue::Element& data);
 
 	/** Swaps the internals of this UserIOHandler with another one.
 	 * @param other A UserIOHandler to swap internals with.
@@ -661,6 +682,24 @@ class CoreExport UserIOHandler : public StreamSocket
 
 typedef unsigned int already_sent_t;
 
+/** Resumes processing the commands of a local user once their penalty has decayed below their penalty threshold. */
+class CoreExport PenaltyTimer final
+	: public Timer
+{
+ private:
+	/** The user this timer is for. */
+	LocalUser* const user;
+
+ public:
+	PenaltyTimer(LocalUser* u)
+		: Timer(0)
+		, user(u)
+	{
+	}
+
+	bool Tick(time_t currtime) override;
+};
+
 class CoreExport LocalUser : public User, public insp::intrusive_list_node<LocalUser>
 {
  private:
@@ -755,6 +794,17 @@ class CoreExport LocalUser : public User, public insp::intrusive_list_node<Local
 	 */
 	unsigned int CommandFloodPenalty = 0;
 
+	/** The monotonic time in milliseconds at which CommandFloodPenalty was last decayed. */
+	uint64_t lastpenaltydecay = 0;
+
+	/** Wakes this user up when they stop being throttled by their penalty. */
+	PenaltyTimer penaltytimer;
+
+	/** Decays CommandFloodPenalty by the amount allowed by the command rate of this user's
+	 * connect class for the time which has passed since it was last decayed.
+	 */
+	void DecayPenalty();
+
 	already_sent_t already_sent = 0;
 
 	/** Check if the user matches a G- or K-line, and disconnect them if they do.
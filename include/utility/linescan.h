@@ -0,0 +1,147 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+// This header does not depend on the rest of the core so that the kernels
+// can be benchmarked on their own by tools/bench-linescan.cpp.
+#include <cstddef>
+#include <cstring>
+
+#if defined __x86_64__ || defined _M_X64
+# include <immintrin.h>
+# define INSPIRCD_LINESCAN_SSE2
+# if defined __GNUC__
+#  define INSPIRCD_LINESCAN_AVX2
+# endif
+# if defined _MSC_VER
+#  include <intrin.h>
+# endif
+#endif
+
+/** The kernels which are used by FindLineControl() and CleanLine(). */
+namespace insp::linescan
+{
+	/** Finds the first carriage return or null character in a buffer. */
+	typedef size_t (*Scanner)(const char*, size_t);
+
+	/** Finds the first carriage return or null character in a buffer one byte at a time. */
+	inline size_t FindScalar(const char* data, size_t len)
+	{
+		for (size_t pos = 0; pos < len; ++pos)
+		{
+			if (data[pos] == '\r' || data[pos] == '\0')
+				return pos;
+		}
+		return len;
+	}
+
+#ifdef INSPIRCD_LINESCAN_SSE2
+	inline unsigned int FirstSetBit(unsigned int mask)
+	{
+#ifdef _MSC_VER
+		unsigned long bit;
+		_BitScanForward(&bit, mask);
+		return bit;
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	/** Finds the first carriage return or null character in a buffer 16 bytes at a time. SSE2 is
+	 * part of the x86-64 baseline so this is always available there.
+	 */
+	inline size_t FindSSE2(const char* data, size_t len)
+	{
+		const __m128i cr = _mm_set1_epi8('\r');
+		const __m128i nul = _mm_setzero_si128();
+
+		size_t pos = 0;
+		for (; pos + sizeof(__m128i) <= len; pos += sizeof(__m128i))
+		{
+			const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+			const __m128i found = _mm_or_si128(_mm_cmpeq_epi8(chunk, cr), _mm_cmpeq_epi8(chunk, nul));
+			const unsigned int mask = _mm_movemask_epi8(found);
+			if (mask)
+				return pos + FirstSetBit(mask);
+		}
+		return pos + FindScalar(data + pos, len - pos);
+	}
+#endif
+
+#ifdef INSPIRCD_LINESCAN_AVX2
+	/** Finds the first carriage return or null character in a buffer 32 bytes at a time. This must
+	 * only be called if the CPU supports AVX2.
+	 */
+	__attribute__((target("avx2")))
+	inline size_t FindAVX2(const char* data, size_t len)
+	{
+		const __m256i cr = _mm256_set1_epi8('\r');
+		const __m256i nul = _mm256_setzero_si256();
+
+		size_t pos = 0;
+		for (; pos + sizeof(__m256i) <= len; pos += sizeof(__m256i))
+		{
+			const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+			const __m256i found = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, cr), _mm256_cmpeq_epi8(chunk, nul));
+			const unsigned int mask = _mm256_movemask_epi8(found);
+			if (mask)
+				return pos + FirstSetBit(mask);
+		}
+
+		// Calling the SSE2 scanner for the tail would incur an AVX to SSE
+		// transition penalty on some CPUs so we handle it here instead.
+		if (pos + sizeof(__m128i) <= len)
+		{
+			const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+			const __m128i found = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm256_castsi256_si128(cr)), _mm_cmpeq_epi8(chunk, _mm256_castsi256_si128(nul)));
+			const unsigned int mask = _mm_movemask_epi8(found);
+			if (mask)
+				return pos + FirstSetBit(mask);
+			pos += sizeof(__m128i);
+		}
+		return pos + FindScalar(data + pos, len - pos);
+	}
+#endif
+
+	/** Removes carriage returns from and replaces null characters with spaces in a buffer.
+	 * @param data The buffer to clean up in place.
+	 * @param len The length of the buffer.
+	 * @param find The scanner to find carriage returns and null characters with.
+	 * @return The length of the buffer after it has been cleaned up.
+	 */
+	inline size_t Clean(char* data, size_t len, Scanner find)
+	{
+		// Most lines contain at most a trailing carriage return so skip over
+		// the clean runs in bulk and only shuffle bytes after one is found.
+		size_t pos = find(data, len);
+		size_t outpos = pos;
+		while (pos < len)
+		{
+			if (data[pos] == '\0')
+				data[outpos++] = ' ';
+			pos++;
+
+			const size_t run = find(data + pos, len - pos);
+			if (outpos != pos)
+				memmove(data + outpos, data + pos, run);
+			outpos += run;
+			pos += run;
+		}
+		return outpos;
+	}
+}
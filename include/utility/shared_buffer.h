@@ -0,0 +1,105 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+namespace insp
+{
+	class shared_buffer;
+}
+
+/** An immutable reference counted buffer of bytes. Copying a shared_buffer does not copy the
+ * underlying bytes so the same data can be queued for sending to many sockets at once.
+ */
+class insp::shared_buffer final
+{
+ private:
+	/** The bytes which are shared between all copies of this buffer or nullptr if empty. */
+	std::shared_ptr<const std::string> buffer;
+
+	/** The position within the shared bytes that this buffer starts at. */
+	std::string::size_type offset = 0;
+
+ public:
+	typedef std::string::size_type size_type;
+	typedef const char* const_iterator;
+
+	/** Initialises a new empty buffer. */
+	shared_buffer() = default;
+
+	/** Initialises a new buffer with a copy of the specified string.
+	 * @param str The string to copy into the buffer.
+	 */
+	shared_buffer(const std::string& str)
+		: buffer(str.empty() ? nullptr : std::make_shared<const std::string>(str))
+	{
+	}
+
+	/** Initialises a new buffer by taking ownership of the specified string.
+	 * @param str The string to move into the buffer.
+	 */
+	shared_buffer(std::string&& str)
+		: buffer(str.empty() ? nullptr : std::make_shared<const std::string>(std::move(str)))
+	{
+	}
+
+	/** Initialises a new buffer with a copy of the specified C string.
+	 * @param str The C string to copy into the buffer.
+	 */
+	shared_buffer(const char* str)
+		: shared_buffer(str, strlen(str))
+	{
+	}
+
+	/** Initialises a new buffer with a copy of the specified bytes.
+	 * @param str The bytes to copy into the buffer.
+	 * @param len The number of bytes to copy.
+	 */
+	shared_buffer(const char* str, size_type len)
+		: buffer(len ? std::make_shared<const std::string>(str, len) : nullptr)
+	{
+	}
+
+	/** Retrieves a pointer to the start of the bytes in this buffer. */
+	const char* data() const { return buffer ? buffer->data() + offset : ""; }
+
+	/** Retrieves the number of bytes in this buffer. */
+	size_type length() const { return buffer ? buffer->length() - offset : 0; }
+
+	/** @copydoc length */
+	size_type size() const { return length(); }
+
+	/** Determines whether this buffer is empty. */
+	bool empty() const { return !length(); }
+
+	/** Retrieves an iterator to the start of the bytes in this buffer. */
+	const_iterator begin() const { return data(); }
+
+	/** Retrieves an iterator to one past the end of the bytes in this buffer. */
+	const_iterator end() const { return data() + length(); }
+
+	/** Removes bytes from the start of this buffer. This only affects this copy of the buffer.
+	 * @param n The number of bytes to remove.
+	 */
+	void remove_prefix(size_type n) { offset += std::min(n, length()); }
+
+	/** Retrieves a view of the bytes in this buffer. */
+	std::string_view view() const { return std::string_view(data(), length()); }
+
+	/** @copydoc view */
+	operator std::string_view() const { return view(); }
+};
@@ -0,0 +1,120 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+/** A glob pattern which has been preprocessed so that it can be matched against many strings
+ * without being parsed again. The pattern is case folded when it is compiled and split at each
+ * '*' into segments which are located in the subject string without backtracking. This produces
+ * the same results as InspIRCd::Match.
+ */
+class CoreExport CompiledMask final
+{
+ private:
+	/** A run of characters between two '*' characters in the pattern. */
+	struct Segment final
+	{
+		/** The position within the folded pattern that this segment starts at. */
+		size_t start;
+
+		/** The number of characters in this segment. */
+		size_t length;
+
+		/** The only character which folds to the first character of this segment or -1 if
+		 * there is more than one such character or the segment starts with a '?'.
+		 */
+		int anchor;
+	};
+
+	/** The pattern as it was originally specified. */
+	std::string mask;
+
+	/** The case map that the pattern was compiled for. */
+	const unsigned char* map = nullptr;
+
+	/** The pattern after it has been passed through the case map. */
+	std::string folded;
+
+	/** The segments of the pattern in the order they must appear. */
+	std::vector<Segment> segments;
+
+	/** Whether the pattern starts with a '*'. */
+	bool leadingstar = false;
+
+	/** Whether the pattern ends with a '*'. */
+	bool trailingstar = false;
+
+	/** The minimum length of a string which can match this pattern. */
+	size_t minlength = 0;
+
+	/** Determines whether the specified characters match a segment.
+	 * @param str The characters to compare. Must be at least as long as the segment.
+	 * @param segment The segment to compare against.
+	 */
+	bool MatchSegment(const char* str, const Segment& segment) const;
+
+	/** Finds the first occurrence of a segment in a string.
+	 * @param str The string to search.
+	 * @param pos The position to start searching at.
+	 * @param segment The segment to search for.
+	 * @return The position the segment was found at or std::string_view::npos if not found.
+	 */
+	size_t FindSegment(std::string_view str, size_t pos, const Segment& segment) const;
+
+ public:
+	/** Initialises a new compiled mask which only matches the empty string. */
+	CompiledMask() = default;
+
+	/** Initialises a new compiled mask from the specified pattern.
+	 * @param pattern The glob pattern to compile.
+	 * @param casemap The case map to compare characters with or nullptr to use the national case map.
+	 */
+	CompiledMask(const std::string& pattern, const unsigned char* casemap = nullptr);
+
+	/** Retrieves the pattern that this mask was compiled from. */
+	const std::string& GetMask() const { return mask; }
+
+	/** Retrieves the case map that this mask was compiled for. */
+	const unsigned char* GetMap() const { return map; }
+
+	/** Determines whether the specified string matches this mask.
+	 * @param str The string to check.
+	 * @return True if the string matches; otherwise, false.
+	 */
+	bool Match(std::string_view str) const;
+
+	/** Determines whether the specified string matches this mask either as a CIDR range or as
+	 * a glob pattern. This is equivalent to InspIRCd::MatchCIDR.
+	 * @param str The string to check.
+	 * @return True if the string matches; otherwise, false.
+	 */
+	bool MatchCIDR(const std::string& str) const;
+
+	/** Retrieves a compiled form of the specified pattern. Recently used patterns are kept in a
+	 * small cache so that patterns which are checked repeatedly, such as list mode entries, do
+	 * not need to be compiled each time they are used.
+	 * @param pattern The glob pattern to retrieve a compiled form of.
+	 * @param casemap The case map to compare characters with or nullptr to use the national case map.
+	 */
+	static std::shared_ptr<const CompiledMask> Get(std::string_view pattern, const unsigned char* casemap = nullptr);
+
+	/** Removes every pattern from the cache used by Get. Cached patterns are keyed on the address
+	 * of their case map so this must be called by anything which changes the contents of a case
+	 * map in place.
+	 */
+	static void ClearCache();
+};
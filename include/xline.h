@@ -120,6 +120,13 @@ class CoreExport XLine : public Cullable
 	 */
 	virtual void OnAdd() { }
 
+	/** Retrieves the mask which either the real host or the IP address of a user must match for
+	 * this line to match them. This is used by XLineIndex to avoid checking lines which can not
+	 * possibly match a user.
+	 * @return The host mask or nullptr if this line does not match users by their host.
+	 */
+	virtual const std::string* GetHostMask() const { return nullptr; }
+
 	/** The time the line was added.
 	 */
 	time_t set_time;
@@ -167,6 +174,8 @@ class CoreExport KLine : public XLine
 	 */
 	KLine(time_t s_time, unsigned long d, const std::string& src, const std::string& re, const std::string& ident, const std::string& host)
 		: XLine(s_time, d, src, re, "K"), identmask(ident), hostmask(host)
+		, identmatch(identmask, ascii_case_insensitive_map)
+		, hostmatch(hostmask, ascii_case_insensitive_map)
 	{
 		matchtext = this->identmask;
 		matchtext.append("@").append(this->hostmask);
@@ -180,6 +189,8 @@ class CoreExport KLine : public XLine
 
 	const std::string& Displayable() override;
 
+	const std::string* GetHostMask() const override { return &hostmask; }
+
 	bool IsBurstable() override;
 
 	/** Ident mask (ident part only)
@@ -189,6 +200,12 @@ class CoreExport KLine : public XLine
 	 */
 	std::string hostmask;
 
+	/** The compiled form of identmask. */
+	CompiledMask identmatch;
+
+	/** The compiled form of hostmask. */
+	CompiledMask hostmatch;
+
 	std::string matchtext;
 };
 
@@ -207,6 +224,8 @@ class CoreExport GLine : public XLine
 	 */
 	GLine(time_t s_time, unsigned long d, const std::string& src, const std::string& re, const std::string& ident, const std::string& host)
 		: XLine(s_time, d, src, re, "G"), identmask(ident), hostmask(host)
+		, identmatch(identmask, ascii_case_insensitive_map)
+		, hostmatch(hostmask, ascii_case_insensitive_map)
 	{
 		matchtext = this->identmask;
 		matchtext.append("@").append(this->hostmask);
@@ -220,6 +239,8 @@ class CoreExport GLine : public XLine
 
 	const std::string& Displayable() override;
 
+	const std::string* GetHostMask() const override { return &hostmask; }
+
 	/** Ident mask (ident part only)
 	 */
 	std::string identmask;
@@ -227,6 +248,12 @@ class CoreExport GLine : public XLine
 	 */
 	std::string hostmask;
 
+	/** The compiled form of identmask. */
+	CompiledMask identmatch;
+
+	/** The compiled form of hostmask. */
+	CompiledMask hostmatch;
+
 	std::string matchtext;
 };
 
@@ -245,6 +272,8 @@ class CoreExport ELine : public XLine
 	 */
 	ELine(time_t s_time, unsigned long d, const std::string& src, const std::string& re, const std::string& ident, const std::string& host)
 		: XLine(s_time, d, src, re, "E"), identmask(ident), hostmask(host)
+		, identmatch(identmask, ascii_case_insensitive_map)
+		, hostmatch(hostmask, ascii_case_insensitive_map)
 	{
 		matchtext = this->identmask;
 		matchtext.append("@").append(this->hostmask);
@@ -260,6 +289,8 @@ class CoreExport ELine : public XLine
 
 	const std::string& Displayable() override;
 
+	const std::string* GetHostMask() const override { return &hostmask; }
+
 	/** Ident mask (ident part only)
 	 */
 	std::string identmask;
@@ -267,6 +298,12 @@ class CoreExport ELine : public XLine
 	 */
 	std::string hostmask;
 
+	/** The compiled form of identmask. */
+	CompiledMask identmatch;
+
+	/** The compiled form of hostmask. */
+	CompiledMask hostmatch;
+
 	std::string matchtext;
 };
 
@@ -295,6 +332,8 @@ class CoreExport ZLine : public XLine
 
 	const std::string& Displayable() override;
 
+	const std::string* GetHostMask() const override { return &ipaddr; }
+
 	/** IP mask (no ident part)
 	 */
 	std::string ipaddr;
@@ -372,6 +411,59 @@ class CoreExport XLineFactory
 	virtual ~XLineFactory() = default;
 };
 
+/** Indexes the X-lines of a single type so that the lines which can match a user can be found
+ * without checking every line. Lines with a literal host, a host which is a literal suffix, or a
+ * CIDR range are looked up by the host and IP address of the user. All other lines are always
+ * returned as candidates.
+ */
+class CoreExport XLineIndex final
+{
+ private:
+	typedef std::vector<XLine*> LineList;
+
+	/** Lines with a literal host indexed by their case folded host. */
+	std::unordered_map<std::string, LineList> exact;
+
+	/** Lines with a host in the format *suffix indexed by their case folded suffix. */
+	std::unordered_map<std::string, LineList> suffixes;
+
+	/** The number of suffixes of each length which are in the index. */
+	std::map<size_t, size_t> suffixlengths;
+
+	/** Lines with a CIDR range indexed by the range. */
+	std::map<irc::sockets::cidr_mask, LineList> ranges;
+
+	/** The number of CIDR ranges of each address family and prefix length which are in the index. */
+	std::map<std::pair<unsigned char, unsigned char>, size_t> rangelengths;
+
+	/** Lines which can not be indexed. */
+	LineList other;
+
+	/** Finds lines with a literal host or suffix which can match the specified host. */
+	void FindHost(const std::string& host, LineList& out) const;
+
+	/** Finds lines with a CIDR range which can match the specified address. */
+	void FindRange(const irc::sockets::sockaddrs& sa, LineList& out) const;
+
+ public:
+	/** Adds a line to the index.
+	 * @param line The line to add.
+	 */
+	void Add(XLine* line);
+
+	/** Removes a line from the index.
+	 * @param line The line to remove.
+	 */
+	void Remove(XLine* line);
+
+	/** Finds the lines which can match the specified user. Each returned line still needs to
+	 * be checked with XLine::Matches.
+	 * @param user The user to find candidate lines for.
+	 * @param out The vector to append the candidate lines to. Each line only appears once.
+	 */
+	void Find(User* user, std::vector<XLine*>& out) const;
+};
+
 /** XLineManager is a class used to manage G-lines, K-lines, E-lines, Z-lines and Q-lines,
  * or any other line created by a module. It also manages XLineFactory classes which
  * can generate a specialized XLine for use by another module.
@@ -379,10 +471,58 @@ class CoreExport XLineFactory
 class CoreExport XLineManager
 {
  protected:
+	/** Applies X-lines to local users a few users at a time so that applying lines on a large
+	 * server does not block the main loop.
+	 */
+	class CoreExport ApplyAction final
+		: public IncrementalAction
+	{
+	 private:
+		/** Applies the lines in the current pass to a user. */
+		void ApplyToUser(LocalUser* user);
+
+	 public:
+		/** Lines which will be applied when the current pass has finished. */
+		std::vector<XLine*> queued;
+
+		/** Whether the E-line exemption of every user will be rechecked when the current pass has finished. */
+		bool queuedexemptcheck = false;
+
+		/** Whether a pass is in progress. */
+		bool running = false;
+
+		/** The lines which are being applied by the current pass in the order they were added. */
+		std::vector<XLine*> lines;
+
+		/** The position of each line in the lines which are being applied. */
+		std::unordered_map<XLine*, size_t> order;
+
+		/** An index of the lines which are being applied. */
+		XLineIndex index;
+
+		/** Whether the current pass rechecks the E-line exemption of every user. */
+		bool exemptcheck = false;
+
+		/** The UUIDs of the local users which existed when the current pass started. */
+		std::vector<std::string> users;
+
+		/** The position within users that the current pass has reached. */
+		size_t position = 0;
+
+		/** Forgets about a line which is being removed. */
+		void Remove(XLine* line);
+
+		/** @copydoc IncrementalAction::Step */
+		bool Step() override;
+	};
+
 	/** Used to hold XLines which have not yet been applied.
 	 */
 	std::vector<XLine *> pending_lines;
 
+	/** Applies lines which have been passed to ApplyLines. */
+	ApplyAction apply_action;
+
 	/** Current xline factories
 	 */
 	XLineFactMap line_factory;
@@ -394,6 +534,9 @@ class CoreExport XLineManager
 	 */
 	XLineContainer lookup_lines;
 
+	/** Indexes of all lines by line type. */
+	std::unordered_map<std::string, XLineIndex> line_index;
+
  public:
 
 	/** Constructor
@@ -409,17 +552,26 @@ class CoreExport XLineManager
 	 */
 	IdentHostPair IdentSplit(const std::string &ident_and_host);
 
-	/** Checks what users match E-lines and sets their ban exempt flag accordingly.
+	/** Checks what users match E-lines and sets their ban exempt flag accordingly. This is
+	 * done along with applying lines at the end of the current main loop iteration.
 	 */
 	void CheckELines();
 
 	/** Get all lines of a certain type to an XLineLookup (std::map<std::string, XLine*>).
 	 * NOTE: When this function runs any expired items are removed from the list before it
-	 * is returned to the caller.
+	 * is returned to the caller unless expire is false.
 	 * @param type The type to look up
+	 * @param expire Whether to remove expired lines first. Callers which look up the same type
+	 *               repeatedly can skip this if they check for expired lines themselves.
 	 * @return A list of all XLines of the given type.
 	 */
-	XLineLookup* GetAll(const std::string &type);
+	XLineLookup* GetAll(const std::string &type, bool expire = true);
+
+	/** Get the number of lines of a certain type without removing expired lines first.
+	 * @param type The type to look up
+	 * @return The number of lines of the given type.
+	 */
+	size_t GetCount(const std::string& type) const;
 
 	/** Remove all lines of a certain type.
 	 */
@@ -494,7 +646,9 @@ class CoreExport XLineManager
 
 	/** Apply any new lines that are pending to be applied.
 	 * This will only apply lines in the pending_lines list, to save on
-	 * CPU time.
+	 * CPU time. The lines are applied starting at the end of the current
+	 * main loop iteration and, on a large server, over several iterations.
+	 * Lines from multiple calls in the same iteration are applied together.
 	 */
 	void ApplyLines();
 
@@ -31,80 +31,124 @@ BanCacheHit::BanCacheHit(const std::string& type, const std::string& reason, tim
 {
 }
 
-BanCacheHit *BanCacheManager::AddHit(const std::string &ip, const std::string &type, const std::string &reason, time_t seconds)
+BanCacheManager::Entry::Entry(const irc::sockets::cidr_mask& addr, const std::string& type, const std::string& reason, time_t seconds, const unsigned long* gen)
+	: address(addr)
+	, hit(type, reason, seconds)
+	, generation(gen)
+	, created(*gen)
 {
-	BanCacheHit*& b = BanHash[ip];
-	if (b != NULL) // can't have two cache entries on the same IP, sorry..
-		return NULL;
+}
 
-	b = new BanCacheHit(type, reason, (seconds ? seconds : 86400));
-	return b;
+size_t BanCacheManager::AddressHash::operator()(const irc::sockets::cidr_mask& address) const
+{
+	// FNV-1a over the address family and the address bits.
+	size_t hash = 2166136261U;
+	hash = (hash ^ address.type) * 16777619U;
+	for (const auto bit : address.bits)
+		hash = (hash ^ bit) * 16777619U;
+	return hash;
 }
 
-BanCacheHit *BanCacheManager::GetHit(const std::string &ip)
+bool BanCacheManager::GetKey(const irc::sockets::sockaddrs& sa, irc::sockets::cidr_mask& key)
 {
-	BanCacheHash::iterator i = this->BanHash.find(ip);
+	// UNIX sockets don't have an address which identifies the client.
+	if (sa.family() != AF_INET && sa.family() != AF_INET6)
+		return false;
 
-	if (i == this->BanHash.end())
-		return NULL; // free and safe
+	key = irc::sockets::cidr_mask(sa, 128);
+	return true;
+}
 
-	if (RemoveIfExpired(i))
-		return NULL; // expired
+bool BanCacheManager::IsValid(const Entry& entry)
+{
+	return *entry.generation == entry.created && ServerInstance->Time() < entry.hit.Expiry;
+}
 
-	return i->second; // hit.
+void BanCacheManager::RemoveEntry(BanCacheHash::iterator it)
+{
+	entries.erase(it->second);
+	BanHash.erase(it);
 }
 
-bool BanCacheManager::RemoveIfExpired(BanCacheHash::iterator& it)
+void BanCacheManager::Trim(size_t maxsize)
 {
-	if (ServerInstance->Time() < it->second->Expiry)
-		return false;
+	while (BanHash.size() > maxsize)
+	{
+		// The least recently used entry is at the back of the list.
+		const Entry& entry = entries.back();
+		if (IsValid(entry))
+			evictions++;
 
-	ServerInstance->Logs.Log("BANCACHE", LOG_DEBUG, "Hit on " + it->first + " is out of date, removing!");
-	delete it->second;
-	it = BanHash.erase(it);
-	return true;
+		BanHash.erase(entry.address);
+		entries.pop_back();
+	}
 }
 
-void BanCacheManager::RemoveEntries(const std::string& type, bool positive)
+BanCacheHit* BanCacheManager::AddHit(const irc::sockets::sockaddrs& sa, const std::string& type, const std::string& reason, time_t seconds)
 {
-	if (positive)
-		ServerInstance->Logs.Log("BANCACHE", LOG_DEBUG, "BanCacheManager::RemoveEntries(): Removing positive hits for " + type);
-	else
-		ServerInstance->Logs.Log("BANCACHE", LOG_DEBUG, "BanCacheManager::RemoveEntries(): Removing all negative hits");
+	irc::sockets::cidr_mask key;
+	if (!GetKey(sa, key))
+		return nullptr;
+
+	const size_t maxsize = ServerInstance->Config->BanCacheSize;
+	if (!maxsize)
+		return nullptr; // The ban cache is disabled.
+
+	BanCacheHash::iterator it = BanHash.find(key);
+	if (it != BanHash.end())
+	{
+		if (IsValid(*it->second))
+			return nullptr; // can't have two cache entries on the same IP, sorry..
 
-	for (BanCacheHash::iterator i = BanHash.begin(); i != BanHash.end(); )
+		RemoveEntry(it);
+	}
+
+	// Make room for the new entry before adding it.
+	Trim(maxsize - 1);
+
+	const unsigned long* generation = type.empty() ? &negativegen : &positivegens[type];
+	entries.emplace_front(key, type, reason, (seconds ? seconds : 86400), generation);
+	BanHash.emplace(key, entries.begin());
+	return &entries.front().hit;
+}
+
+BanCacheHit* BanCacheManager::GetHit(const irc::sockets::sockaddrs& sa)
+{
+	irc::sockets::cidr_mask key;
+	if (!GetKey(sa, key))
+		return nullptr;
+
+	BanCacheHash::iterator it = BanHash.find(key);
+	if (it == BanHash.end())
+	{
+		misses++;
+		return nullptr; // free and safe
+	}
+
+	if (!IsValid(*it->second))
 	{
-		if (RemoveIfExpired(i))
-			continue; // updates the iterator if expired
-
-		BanCacheHit* b = i->second;
-		bool remove = false;
-
-		if (positive)
-		{
-			// when removing positive hits, remove only if the type matches
-			remove = b->IsPositive() && (b->Type == type);
-		}
-		else
-		{
-			// when removing negative hits, remove all of them
-			remove = !b->IsPositive();
-		}
-
-		if (remove)
-		{
-			/* we need to remove this one. */
-			ServerInstance->Logs.Log("BANCACHE", LOG_DEBUG, "BanCacheManager::RemoveEntries(): Removing a hit on " + i->first);
-			delete b;
-			i = BanHash.erase(i);
-		}
-		else
-			++i;
+		ServerInstance->Logs.Log("BANCACHE", LOG_DEBUG, "Hit on " + key.str() + " is out of date, removing!");
+		RemoveEntry(it);
+		misses++;
+		return nullptr;
 	}
+
+	// Move the entry to the front of the list as it is now the most recently used.
+	entries.splice(entries.begin(), entries, it->second);
+	hits++;
+	return &it->second->hit;
 }
 
-BanCacheManager::~BanCacheManager()
+void BanCacheManager::RemoveEntries(const std::string& type, bool positive)
 {
-	for (const auto& [_, hit] : BanHash)
-		delete hit;
+	if (positive)
+	{
+		ServerInstance->Logs.Log("BANCACHE", LOG_DEBUG, "BanCacheManager::RemoveEntries(): Removing positive hits for " + type);
+		positivegens[type]++;
+	}
+	else
+	{
+		ServerInstance->Logs.Log("BANCACHE", LOG_DEBUG, "BanCacheManager::RemoveEntries(): Removing all negative hits");
+		negativegen++;
+	}
 }
@@ -31,6 +31,9 @@
 namespace
 {
 	ChanModeReference ban(NULL, "ban");
+
+	/** A number which changes whenever every cached ban check result becomes stale. */
+	unsigned long banepoch = 1;
 }
 
 Channel::Channel(const std::string &cname, time_t ts)
@@ -73,9 +76,96 @@ Membership* Channel::AddUser(User* user)
 		return NULL;
 
 	Membership* memb = new(ret.first->second) Membership(user, this);
+	AddRanked(memb, 0);
+	CountServerMember(user, true);
 	return memb;
 }
 
+void Channel::CountServerMember(User* user, bool adding)
+{
+	if (IS_LOCAL(user))
+		return;
+
+	for (auto it = memberservers.begin(); it != memberservers.end(); ++it)
+	{
+		if (it->server != user->server)
+			continue;
+
+		if (adding)
+			it->count++;
+		else if (!--it->count)
+		{
+			*it = memberservers.back();
+			memberservers.pop_back();
+		}
+		return;
+	}
+
+	if (adding)
+		memberservers.push_back({ user->server, 1 });
+}
+
+Channel::RankedMemberList& Channel::GetRankedList(const Membership* memb)
+{
+	return IS_LOCAL(memb->user) ? localmembers : remotemembers;
+}
+
+void Channel::AddRanked(Membership* memb, unsigned int rank)
+{
+	RankedMemberList& list = GetRankedList(memb);
+
+	// Open a gap at the end of the list and then move it forward by swapping it with the
+	// first member of each lower ranked group until it is at the end of the right group.
+	size_t pos = list.size();
+	list.emplace_back();
+	while (pos && list[pos - 1].rank < rank)
+	{
+		const unsigned int grouprank = list[pos - 1].rank;
+		const auto groupstart = std::partition_point(list.begin(), list.begin() + pos, [grouprank](const RankedMember& member) {
+			return member.rank > grouprank;
+		});
+
+		list[pos] = *groupstart;
+		list[pos].memb->rankpos = pos;
+		pos = groupstart - list.begin();
+	}
+
+	list[pos] = { rank, memb->user, memb };
+	memb->rankpos = pos;
+}
+
+void Channel::DelRanked(Membership* memb)
+{
+	RankedMemberList& list = GetRankedList(memb);
+
+	// Fill the gap left by the member with the last member of the group which follows it
+	// until the gap reaches the end of the list.
+	size_t pos = memb->rankpos;
+	while (pos + 1 < list.size())
+	{
+		const unsigned int grouprank = list[pos + 1].rank;
+		const auto groupend = std::partition_point(list.begin() + pos + 1, list.end(), [grouprank](const RankedMember& member) {
+			return member.rank >= grouprank;
+		});
+
+		const size_t last = (groupend - list.begin()) - 1;
+		list[pos] = list[last];
+		list[pos].memb->rankpos = pos;
+		pos = last;
+	}
+	list.pop_back();
+}
+
+void Channel::UpdateRank(Membership* memb)
+{
+	const unsigned int rank = memb->getRank();
+	if (GetRankedList(memb)[memb->rankpos].rank == rank)
+		return;
+
+	DelRanked(memb);
+	AddRanked(memb, rank);
+}
+
 void Channel::DelUser(User* user)
 {
 	MemberMap::iterator it = userlist.find(user);
@@ -106,6 +196,8 @@ void Channel::CheckDestroy()
 void Channel::DelUser(const MemberMap::iterator& membiter)
 {
 	Membership* memb = membiter->second;
+	DelRanked(memb);
+	CountServerMember(memb->user, false);
 	memb->Cull();
 	memb->~Membership();
 	userlist.erase(membiter);
@@ -283,6 +375,81 @@ Membership* Channel::ForceJoin(User* user, const std::string* privs, bool bursti
 	return memb;
 }
 
+/** Checks whether a user matches any of the nick!user@host entries in a ban list.
+ * @param chan The channel the ban list is for.
+ * @param user The user to check.
+ * @param banlm The mode which the ban list belongs to.
+ * @param bans The index of the ban list.
+ * @param cacheable Set to false if the result depends on a module which can match entries against anything.
+ */
+static bool CheckMaskBans(Channel* chan, User* user, ListModeBase* banlm, const ListModeBase::MaskIndex& bans, bool& cacheable)
+{
+	for (const auto* entry : bans.cidr)
+	{
+		if (chan->CheckBan(user, entry->mask))
+			return true;
+	}
+
+	for (const auto* entry : bans.wildcard)
+	{
+		if (chan->CheckBan(user, entry->mask))
+			return true;
+	}
+
+	// Modules which match entries against other hosts (e.g. cloaks) can tell
+	// us what those hosts are so that they can be looked up in the index.
+	std::vector<std::string> extrahosts;
+	FOREACH_MOD(OnGetBanHosts, (user, extrahosts));
+
+	// The module which provides the ban mode only listens to OnCheckBan for
+	// extbans. If another module is listening without telling us which hosts
+	// it matches entries against then every entry with a literal host has to
+	// be checked and the result can depend on anything about the user.
+	const auto& banhosthandlers = ServerInstance->Modules.EventHandlers[I_OnGetBanHosts];
+	const bool unknownhandler = std::any_of(ServerInstance->Modules.EventHandlers[I_OnCheckBan].begin(),
+		ServerInstance->Modules.EventHandlers[I_OnCheckBan].end(), [&](Module* mod) {
+			return mod != banlm->creator && !stdalgo::isin(banhosthandlers, mod);
+		});
+
+	if (unknownhandler)
+	{
+		cacheable = false;
+		for (const auto& [_, entries] : bans.exact)
+		{
+			for (const auto* entry : entries)
+			{
+				if (chan->CheckBan(user, entry->mask))
+					return true;
+			}
+		}
+		return false;
+	}
+
+	// Otherwise an entry with a literal host can only match a user with that host.
+	std::vector<const std::string*> hosts = { &user->GetRealHost(), &user->GetDisplayedHost(), &user->GetIPString() };
+	for (const auto& extrahost : extrahosts)
+		hosts.push_back(&extrahost);
+
+	for (size_t idx = 0; idx < hosts.size(); ++idx)
+	{
+		// Avoid checking the same entries twice if the user's hosts are the same.
+		const auto duplicate = [&](const std::string* host) { return irc::equals(*host, *hosts[idx]); };
+		if (std::any_of(hosts.begin(), hosts.begin() + idx, duplicate))
+			continue;
+
+		auto it = bans.exact.find(*hosts[idx]);
+		if (it == bans.exact.end())
+			continue;
+
+		for (const auto* entry : it->second)
+		{
+			if (chan->CheckBan(user, entry->mask))
+				return true;
+		}
+	}
+	return false;
+}
+
 bool Channel::IsBanned(User* user)
 {
 	ModResult result;
@@ -295,16 +462,40 @@ bool Channel::IsBanned(User* user)
 	if (!banlm)
 		return false;
 
-	const ListModeBase::ModeList* bans = banlm->GetList(this);
-	if (bans)
+	const ListModeBase::MaskIndex* bans = banlm->GetIndex(this);
+	if (!bans)
+		return false;
+
+	// Entries which are not nick!user@host masks (e.g. extbans) can depend on
+	// anything about the user so they are always checked.
+	for (const auto* entry : bans->other)
 	{
-		for (const auto& entry : *bans)
-		{
-			if (CheckBan(user, entry.mask))
-				return true;
-		}
+		if (CheckBan(user, entry->mask))
+			return true;
 	}
-	return false;
+
+	// Whether a nick!user@host mask matches only depends on the entry and the
+	// masks of the user so a member can reuse the last result until either of
+	// those change unless a module which can match against anything was used.
+	Membership* memb = GetUser(user);
+	if (memb && memb->banepoch == banepoch && memb->banlistgen == bans->generation && memb->banmaskgen == user->GetMaskGeneration())
+		return memb->banned;
+
+	bool cacheable = true;
+	const bool banned = CheckMaskBans(this, user, banlm, *bans, cacheable);
+	if (memb && cacheable)
+	{
+		memb->banepoch = banepoch;
+		memb->banlistgen = bans->generation;
+		memb->banmaskgen = user->GetMaskGeneration();
+		memb->banned = banned;
+	}
+	return banned;
+}
+
+void Channel::InvalidateBanCache()
+{
+	banepoch++;
 }
 
 bool Channel::CheckBan(User* user, const std::string& mask)
@@ -319,13 +510,13 @@ bool Channel::CheckBan(User* user, const std::string& mask)
 		return false;
 
 	const std::string nickIdent = user->nick + "!" + user->ident;
-	std::string prefix(mask, 0, at);
-	if (InspIRCd::Match(nickIdent, prefix, NULL))
+	const std::string_view maskview(mask);
+	if (CompiledMask::Get(maskview.substr(0, at))->Match(nickIdent))
 	{
-		std::string suffix(mask, at + 1);
-		if (InspIRCd::Match(user->GetRealHost(), suffix, NULL) ||
-			InspIRCd::Match(user->GetDisplayedHost(), suffix, NULL) ||
-			InspIRCd::MatchCIDR(user->GetIPString(), suffix, NULL))
+		const std::shared_ptr<const CompiledMask> suffix = CompiledMask::Get(maskview.substr(at + 1));
+		if (suffix->Match(user->GetRealHost()) ||
+			suffix->Match(user->GetDisplayedHost()) ||
+			suffix->MatchCIDR(user->GetIPString()))
 			return true;
 	}
 	return false;
@@ -380,17 +571,15 @@ void Channel::Write(ClientProtocol::Event& protoev, char status, const CUList& e
 			minrank = mh->GetPrefixRank();
 	}
 
-	for (const auto& [u, memb] : userlist)
+	for (const auto& member : localmembers)
 	{
-		LocalUser* user = IS_LOCAL(u);
-		if ((user) && (!except_list.count(user)))
-		{
-			/* User doesn't have the status we're after */
-			if (minrank && memb->getRank() < minrank)
-				continue;
+		// Members are grouped by rank so nobody after this has the status we're after.
+		if (member.rank < minrank)
+			break;
 
+		LocalUser* user = static_cast<LocalUser*>(member.user);
+		if (!except_list.count(user))
 			user->Send(protoev);
-		}
 	}
 }
 
@@ -499,6 +688,8 @@ unsigned int Channel::GetPrefixValue(User* user)
 bool Membership::SetPrefix(PrefixMode* delta_mh, bool adding)
 {
 	char prefix = delta_mh->GetModeChar();
+	bool changed = adding;
+	bool found = false;
 	for (unsigned int i = 0; i < modes.length(); i++)
 	{
 		char mchar = modes[i];
@@ -508,12 +699,17 @@ bool Membership::SetPrefix(PrefixMode* delta_mh, bool adding)
 			modes = modes.substr(0,i) +
 				(adding ? std::string(1, prefix) : "") +
 				modes.substr(mchar == prefix ? i+1 : i);
-			return adding != (mchar == prefix);
+			changed = adding != (mchar == prefix);
+			found = true;
+			break;
 		}
 	}
-	if (adding)
+	if (adding && !found)
 		modes.push_back(prefix);
-	return adding;
+
+	if (changed)
+		chan->UpdateRank(this);
+	return changed;
 }
 
 
@@ -169,7 +169,7 @@ CmdResult CommandParser::CallHandler(const std::string& commandname, const Comma
 	return CmdResult::INVALID;
 }
 
-void CommandParser::ProcessCommand(LocalUser* user, std::string& command, CommandBase::Params& command_p)
+void CommandParser::ProcessCommand(LocalUser* user, std::string& command, CommandBase::Params& command_p, size_t length)
 {
 	/* find the command, check it exists */
 	Command* handler = GetHandler(command);
@@ -321,24 +321,49 @@ void CommandParser::ProcessCommand(LocalUser* user, std::string& command, Comman
 	{
 		/* passed all checks.. first, do the (ugly) stats counters. */
 		handler->use_count++;
+		handler->bytes_in += length;
+
+		const auto start = std::chrono::steady_clock::now();
+		const unsigned int bytes_out = user->bytes_out;
 
 		/* module calls too */
 		FIRST_MOD_RESULT(OnPreCommand, MOD_RESULT, (command, command_p, user, true));
 		if (MOD_RESULT == MOD_RES_DENY)
 		{
 			FOREACH_MOD(OnCommandBlocked, (command, command_p, user));
-			return;
 		}
+		else
+		{
+			/*
+			 * WARNING: be careful, the user may be deleted soon
+			 */
+			CmdResult result = handler->Handle(user, command_p);
 
-		/*
-		 * WARNING: be careful, the user may be deleted soon
-		 */
-		CmdResult result = handler->Handle(user, command_p);
+			FOREACH_MOD(OnPostCommand, (handler, command_p, user, result, false));
+		}
 
-		FOREACH_MOD(OnPostCommand, (handler, command_p, user, result, false));
+		// The user object is not deleted until the end of the main loop iteration so this is
+		// safe even if they quit while executing the command.
+		handler->bytes_out += user->bytes_out - bytes_out;
+		RecordLatency(user, handler, std::chrono::steady_clock::now() - start);
 	}
 }
 
+void CommandParser::RecordLatency(LocalUser* user, Command* handler, const LatencyHistogram::Duration& latency)
+{
+	handler->latency.Add(latency);
+	ServerInstance->LoopStats.AddActivity(latency, [user, handler] {
+		return "command " + handler->name + " from " + user->GetFullRealHost();
+	});
+
+	const unsigned long threshold = ServerInstance->Config->SlowCommandThreshold;
+	if (!threshold || latency < std::chrono::milliseconds(threshold))
+		return;
+
+	ServerInstance->SNO.WriteToSnoMask('p', "Slow command: %s took %.1fms to execute %s",
+		user->GetFullRealHost().c_str(), std::chrono::duration<double, std::milli>(latency).count(), handler->name.c_str());
+}
+
 void CommandParser::RemoveCommand(Command* x)
 {
 	CommandMap::iterator n = cmdlist.find(x->name);
@@ -346,7 +371,7 @@ void CommandParser::RemoveCommand(Command* x)
 		cmdlist.erase(n);
 }
 
-void CommandParser::ProcessBuffer(LocalUser* user, const std::string& buffer)
+void CommandParser::ProcessBuffer(LocalUser* user, std::string_view buffer)
 {
 	ClientProtocol::ParseOutput parseoutput;
 	if (!user->serializer->Parse(user, buffer, parseoutput))
@@ -356,7 +381,7 @@ void CommandParser::ProcessBuffer(LocalUser* user, const std::string& buffer)
 	std::transform(command.begin(), command.end(), command.begin(), ::toupper);
 
 	CommandBase::Params parameters(parseoutput.params, parseoutput.tags);
-	ProcessCommand(user, command, parameters);
+	ProcessCommand(user, command, parameters, buffer.length());
 }
 
 bool CommandParser::AddCommand(Command *f)
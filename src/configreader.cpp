@@ -266,7 +266,7 @@ void ServerConfig::CrossCheckConnectBlocks(ServerConfig* current)
 			me->hardsendqmax = tag->getUInt("hardsendq", me->hardsendqmax);
 			me->recvqmax = tag->getUInt("recvq", me->recvqmax);
 			me->penaltythreshold = tag->getUInt("threshold", me->penaltythreshold);
-			me->commandrate = tag->getUInt("commandrate", me->commandrate);
+			me->commandrate = tag->getUInt("commandrate", me->commandrate, 1);
 			me->fakelag = tag->getBool("fakelag", me->fakelag);
 			me->maxlocal = tag->getUInt("localmax", me->maxlocal);
 			me->maxglobal = tag->getUInt("globalmax", me->maxglobal);
@@ -348,7 +348,11 @@ void ServerConfig::Fill()
 	SoftLimit = ConfValue("performance")->getUInt("softlimit", (SocketEngine::GetMaxFds() > 0 ? SocketEngine::GetMaxFds() : LONG_MAX), 10);
 	CCOnConnect = ConfValue("performance")->getBool("clonesonconnect", true);
 	MaxConn = ConfValue("performance")->getUInt("somaxconn", SOMAXCONN);
+	BanCacheSize = ConfValue("performance")->getUInt("bancachesize", 50000);
 	TimeSkipWarn = ConfValue("performance")->getDuration("timeskipwarn", 2, 0, 30);
+	SlowCommandThreshold = ConfValue("performance")->getUInt("slowcommand", 0);
+	LoopBudget = ConfValue("performance")->getUInt("loopbudget", 0);
+	ProfileHooks = ConfValue("performance")->getBool("profilehooks");
 	XLineMessage = options->getString("xlinemessage", "You're banned!", 1);
 	ServerDesc = server->getString("description", "Configure Me", 1);
 	Network = server->getString("network", "Network", 1);
@@ -688,6 +692,9 @@ void ConfigReaderThread::OnStop()
 			}
 		}
 
+		// Modules may match bans differently now (e.g. the cloak keys may have changed).
+		Channel::InvalidateBanCache();
+
 		// The description of this server may have changed - update it for WHOIS etc.
 		ServerInstance->FakeClient->server->description = Config->ServerDesc;
 
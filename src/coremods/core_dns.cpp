@@ -347,6 +347,12 @@ class MyManager : public Manager, public Timer, public EventHandler
 	irc::sockets::sockaddrs myserver;
 	bool unloading = false;
 
+	/** The number of requests which have been answered from the cache. */
+	unsigned long cachehits = 0;
+
+	/** The number of requests which could not be answered from the cache. */
+	unsigned long cachemisses = 0;
+
 	/** Maximum number of entries in cache
 	 */
 	static const unsigned int MAX_CACHE_SIZE = 1000;
@@ -366,15 +372,21 @@ class MyManager : public Manager, public Timer, public EventHandler
 
 		cache_map::iterator it = this->cache.find(question);
 		if (it == this->cache.end())
+		{
+			cachemisses++;
 			return false;
+		}
 
 		Query& record = it->second;
 		if (IsExpired(record))
 		{
 			this->cache.erase(it);
+			cachemisses++;
 			return false;
 		}
 
+		cachehits++;
+
 		ServerInstance->Logs.Log(MODNAME, LOG_DEBUG, "cache: Using cached result for " + question.name);
 		record.cached = true;
 		req->OnLookupComplete(&record);
@@ -580,6 +592,21 @@ class MyManager : public Manager, public Timer, public EventHandler
 		}
 	}
 
+	size_t GetCacheSize() const override
+	{
+		return cache.size();
+	}
+
+	unsigned long GetCacheHits() const override
+	{
+		return cachehits;
+	}
+
+	unsigned long GetCacheMisses() const override
+	{
+		return cachemisses;
+	}
+
 	void OnEventHandlerError(int errcode) override
 	{
 		ServerInstance->Logs.Log(MODNAME, LOG_DEBUG, "UDP socket got an error event");
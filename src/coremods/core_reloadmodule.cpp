@@ -31,7 +31,7 @@ static ClientProtocol::Serializer* dummyserializer;
 
 class DummySerializer : public ClientProtocol::Serializer
 {
- 	bool Parse(LocalUser* user, const std::string& line, ClientProtocol::ParseOutput& parseoutput) override
+ 	bool Parse(LocalUser* user, std::string_view line, ClientProtocol::ParseOutput& parseoutput) override
  	{
  		return false;
  	}
@@ -503,6 +503,17 @@ void DataKeeper::Save(Module* currmod)
 
 	reloadevprov->Call(&ReloadModule::EventListener::OnReloadModuleSave, mod, this->moddata);
 
+	// The module being reloaded is already marked as dying so the event provider skips its handlers.
+	for (auto* subscriber : reloadevprov->GetSubscribers())
+	{
+		if (subscriber->GetModule() == mod)
+			static_cast<ReloadModule::EventListener*>(subscriber)->OnReloadModuleSave(mod, this->moddata);
+	}
+
+	// The handlers of the module being reloaded are destroyed with it so their data is restored by the new instance.
+	for (auto& data : moddata.list)
+		data.ownmodule = (data.handler->GetModule() == mod);
+
 	ServerInstance->Logs.Log(MODNAME, LOG_DEBUG, "Saved data about %zu users %zu chans %zu modules", userdatalist.size(), chandatalist.size(), moddata.list.size());
 }
 
@@ -664,8 +675,26 @@ void DataKeeper::DoRestoreModules()
 {
 	for (const auto& data : moddata.list)
 	{
-		ServerInstance->Logs.Log(MODNAME, LOG_DEBUG, "Calling module data handler %p", static_cast<void*>(data.handler));
-		data.handler->OnReloadModuleRestore(mod, data.data);
+		EventListener* handler = data.handler;
+		if (data.ownmodule)
+		{
+			handler = nullptr;
+			for (auto* subscriber : reloadevprov->GetSubscribers())
+			{
+				if (mod && subscriber->GetModule() == mod)
+					handler = static_cast<EventListener*>(subscriber);
+			}
+
+			if (!handler)
+			{
+				ServerInstance->Logs.Log(MODNAME, LOG_DEBUG, "No module data handler to restore the data of the reloaded module");
+				delete static_cast<std::string*>(data.data);
+				continue;
+			}
+		}
+
+		ServerInstance->Logs.Log(MODNAME, LOG_DEBUG, "Calling module data handler %p", static_cast<void*>(handler));
+		handler->OnReloadModuleRestore(mod, data.data);
 	}
 }
 
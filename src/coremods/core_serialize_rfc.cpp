@@ -43,14 +43,14 @@ class RFCSerializer : public ClientProtocol::Serializer
 	{
 	}
 
- 	bool Parse(LocalUser* user, const std::string& line, ClientProtocol::ParseOutput& parseoutput) override;
+ 	bool Parse(LocalUser* user, std::string_view line, ClientProtocol::ParseOutput& parseoutput) override;
 	ClientProtocol::SerializedMessage Serialize(const ClientProtocol::Message& msg, const ClientProtocol::TagSelection& tagwl) const override;
 };
 
-bool RFCSerializer::Parse(LocalUser* user, const std::string& line, ClientProtocol::ParseOutput& parseoutput)
+bool RFCSerializer::Parse(LocalUser* user, std::string_view line, ClientProtocol::ParseOutput& parseoutput)
 {
-	size_t start = line.find_first_not_of(" ");
-	if (start == std::string::npos)
+	size_t start = line.find_first_not_of(' ');
+	if (start == std::string_view::npos)
 	{
 		// Discourage the user from flooding the server.
 		user->CommandFloodPenalty += 2000;
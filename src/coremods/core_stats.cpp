@@ -218,6 +218,8 @@ void CommandStats::DoStats(Stats::Context& stats)
 			stats.AddRow(249, "Read events:  "+ConvToStr(sestats.ReadEvents));
 			stats.AddRow(249, "Write events: "+ConvToStr(sestats.WriteEvents));
 			stats.AddRow(249, "Error events: "+ConvToStr(sestats.ErrorEvents));
+			stats.AddRow(249, "Change calls: "+ConvToStr(sestats.ChangeCalls));
+			stats.AddRow(249, "Coalesced changes: "+ConvToStr(sestats.ChangesCoalesced));
 			break;
 		}
 
@@ -235,6 +237,79 @@ void CommandStats::DoStats(Stats::Context& stats)
 		}
 		break;
 
+		/* stats W (main loop phase times) */
+		case 'W':
+		{
+			const auto format = [](const LatencyHistogram::Duration& duration) {
+				return std::chrono::duration<double, std::milli>(duration).count();
+			};
+
+			const auto& window = ServerInstance->LoopStats.GetWindow();
+			for (size_t idx = 0; idx <= LoopProfiler::PHASE_COUNT; ++idx)
+			{
+				const LatencyHistogram& hist = window[idx];
+				stats.AddRow(249, InspIRCd::Format("%s: p50 %.3fms, p90 %.3fms, p99 %.3fms, p99.9 %.3fms, max %.3fms",
+					LoopProfiler::GetPhaseName(static_cast<LoopProfiler::Phase>(idx)), format(hist.GetPercentile(50)),
+					format(hist.GetPercentile(90)), format(hist.GetPercentile(99)), format(hist.GetPercentile(99.9)),
+					format(hist.GetMax())));
+			}
+
+			stats.AddRow(249, InspIRCd::Format("%lu iterations in a %llds window; %lu iterations have exceeded the loop budget since startup",
+				window[LoopProfiler::PHASE_COUNT].GetCount(), static_cast<long long>(LoopProfiler::WINDOW.count()),
+				ServerInstance->LoopStats.GetStalls()));
+		}
+		break;
+
+		/* stats M (command latency percentiles and byte counts) */
+		case 'M':
+		{
+			const auto format = [](const LatencyHistogram::Duration& duration) {
+				return std::chrono::duration<double, std::milli>(duration).count();
+			};
+
+			for (const auto& [_, command] : ServerInstance->Parser.GetCommands())
+			{
+				const LatencyHistogram& hist = command->latency;
+				if (!hist.GetCount())
+					continue;
+
+				stats.AddRow(249, InspIRCd::Format("%s: %lu calls, %llu bytes in, %llu bytes out, p50 %.3fms, p90 %.3fms, p99 %.3fms, p99.9 %.3fms, max %.3fms",
+					command->name.c_str(), hist.GetCount(), command->bytes_in, command->bytes_out, format(hist.GetPercentile(50)),
+					format(hist.GetPercentile(90)), format(hist.GetPercentile(99)), format(hist.GetPercentile(99.9)),
+					format(hist.GetMax())));
+			}
+		}
+		break;
+
+		/* stats h (time spent in module hooks, slowest first) */
+		case 'h':
+		{
+			typedef std::tuple<const Module*, const std::string*, const HookStats*> HookEntry;
+			std::vector<HookEntry> hooks;
+			for (const auto& [_, mod] : ServerInstance->Modules.GetModules())
+			{
+				for (const auto& [hookname, hookstats] : mod->hookstats)
+					hooks.emplace_back(mod, &hookname, &hookstats);
+			}
+
+			std::sort(hooks.begin(), hooks.end(), [](const HookEntry& lhs, const HookEntry& rhs) {
+				return std::get<2>(lhs)->total > std::get<2>(rhs)->total;
+			});
+
+			for (const auto& [mod, hookname, hookstats] : hooks)
+			{
+				const double total = std::chrono::duration<double, std::micro>(hookstats->total).count();
+				const double max = std::chrono::duration<double, std::micro>(hookstats->max).count();
+				stats.AddRow(249, InspIRCd::Format("%s %s: %llu calls, %.1fus total, %.1fus average, %.1fus max",
+					mod->ModuleSourceFile.c_str(), hookname->c_str(), hookstats->calls, total,
+					hookstats->calls ? total / hookstats->calls : 0, max));
+			}
+
+			if (!ServerInstance->Config->ProfileHooks)
+				stats.AddRow(249, "Hook profiling is disabled; enable <performance:profilehooks> to record hook latencies");
+		}
+		break;
+
 		/* stats z (debug and memory info) */
 		case 'z':
 		{
@@ -242,6 +317,10 @@ void CommandStats::DoStats(Stats::Context& stats)
 			stats.AddRow(249, "Channels: "+ConvToStr(ServerInstance->GetChans().size()));
 			stats.AddRow(249, "Commands: "+ConvToStr(ServerInstance->Parser.GetCommands().size()));
 
+			const BanCacheManager& bancache = ServerInstance->BanCache;
+			stats.AddRow(249, InspIRCd::Format("Ban cache: %zu/%zu entries; Hits: %lu; Misses: %lu; Evictions: %lu",
+				bancache.GetSize(), ServerInstance->Config->BanCacheSize, bancache.GetHits(), bancache.GetMisses(), bancache.GetEvictions()));
+
 			float kbitpersec_in, kbitpersec_out, kbitpersec_total;
 			SocketEngine::GetStats().GetBandwidth(kbitpersec_in, kbitpersec_out, kbitpersec_total);
 
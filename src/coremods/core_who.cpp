@@ -46,6 +46,12 @@ static const char who_field_order[] = "cuhsnf";
 
 struct WhoData : public Who::Request
 {
+	/** The match text compiled for comparing with the ASCII case map. */
+	CompiledMask asciimatch;
+
+	/** The match text compiled for comparing with the national case map. */
+	CompiledMask nationalmatch;
+
 	bool GetFieldIndex(char flag, size_t& out) const override
 	{
 		if (!whox)
@@ -109,6 +115,10 @@ struct WhoData : public Who::Request
 
 		// Fuzzy matches are when the source has not specified a specific user.
 		fuzzy_match = flags.any() || (matchtext.find_first_of("*?.") != std::string::npos);
+
+		// The match text is compared against every visible user so only parse it once.
+		asciimatch = CompiledMask(matchtext, ascii_case_insensitive_map);
+		nationalmatch = CompiledMask(matchtext);
 	}
 };
 
@@ -243,26 +253,26 @@ bool CommandWho::MatchUser(LocalUser* source, User* user, WhoData& data)
 	// The source wants to match against users' away messages.
 	bool match = false;
 	if (data.flags['A'])
-		match = user->IsAway() && InspIRCd::Match(user->awaymsg, data.matchtext, ascii_case_insensitive_map);
+		match = user->IsAway() && data.asciimatch.Match(user->awaymsg);
 
 	// The source wants to match against users' account names.
 	else if (data.flags['a'])
 	{
 		const AccountExtItem* accountext = GetAccountExtItem();
 		const std::string* account = accountext ? accountext->Get(user) : NULL;
-		match = account && InspIRCd::Match(*account, data.matchtext);
+		match = account && data.nationalmatch.Match(*account);
 	}
 
 	// The source wants to match against users' hostnames.
 	else if (data.flags['h'])
 	{
 		const std::string host = user->GetHost(source_can_see_target && data.flags['x']);
-		match = InspIRCd::Match(host, data.matchtext, ascii_case_insensitive_map);
+		match = data.asciimatch.Match(host);
 	}
 
 	// The source wants to match against users' IP addresses.
 	else if (data.flags['i'])
-		match = source_can_see_target && InspIRCd::MatchCIDR(user->GetIPString(), data.matchtext, ascii_case_insensitive_map);
+		match = source_can_see_target && data.asciimatch.MatchCIDR(user->GetIPString());
 
 	// The source wants to match against users' modes.
 	else if (data.flags['m'])
@@ -298,7 +308,7 @@ bool CommandWho::MatchUser(LocalUser* source, User* user, WhoData& data)
 
 	// The source wants to match against users' nicks.
 	else if (data.flags['n'])
-		match = InspIRCd::Match(user->nick, data.matchtext);
+		match = data.nationalmatch.Match(user->nick);
 
 	// The source wants to match against users' connection ports.
 	else if (data.flags['p'])
@@ -320,13 +330,13 @@ bool CommandWho::MatchUser(LocalUser* source, User* user, WhoData& data)
 
 	// The source wants to match against users' real names.
 	else if (data.flags['r'])
-		match = InspIRCd::Match(user->GetRealName(), data.matchtext, ascii_case_insensitive_map);
+		match = data.asciimatch.Match(user->GetRealName());
 
 	else if (data.flags['s'])
 	{
 		bool show_real_server_name = ServerInstance->Config->HideServer.empty() || (source->HasPrivPermission("servers/auspex") && data.flags['x']);
 		const std::string server = show_real_server_name ? user->server->GetName() : ServerInstance->Config->HideServer;
-		match = InspIRCd::Match(server, data.matchtext, ascii_case_insensitive_map);
+		match = data.asciimatch.Match(server);
 	}
 
 	// The source wants to match against users' connection times.
@@ -339,27 +349,27 @@ bool CommandWho::MatchUser(LocalUser* source, User* user, WhoData& data)
 
 	// The source wants to match against users' idents.
 	else if (data.flags['u'])
-		match = InspIRCd::Match(user->ident, data.matchtext, ascii_case_insensitive_map);
+		match = data.asciimatch.Match(user->ident);
 
 	// The <name> passed to WHO is matched against users' host, server,
 	// real name and nickname if the channel <name> cannot be found.
 	else
 	{
 		const std::string host = user->GetHost(source_can_see_target && data.flags['x']);
-		match = InspIRCd::Match(host, data.matchtext, ascii_case_insensitive_map);
+		match = data.asciimatch.Match(host);
 
 		if (!match)
 		{
 			bool show_real_server_name = ServerInstance->Config->HideServer.empty() || (source->HasPrivPermission("servers/auspex") && data.flags['x']);
 			const std::string server = show_real_server_name ? user->server->GetName() : ServerInstance->Config->HideServer;
-			match = InspIRCd::Match(server, data.matchtext, ascii_case_insensitive_map);
+			match = data.asciimatch.Match(server);
 		}
 
 		if (!match)
-			match = InspIRCd::Match(user->GetRealName(), data.matchtext, ascii_case_insensitive_map);
+			match = data.asciimatch.Match(user->GetRealName());
 
 		if (!match)
-			match = InspIRCd::Match(user->nick, data.matchtext);
+			match = data.nationalmatch.Match(user->nick);
 	}
 
 	return match;
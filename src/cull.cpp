@@ -121,3 +121,28 @@ void ActionList::Run()
 	}
 	list.clear();
 }
+
+void IncrementalActionList::AddAction(IncrementalAction* item)
+{
+	if (std::find(list.begin(), list.end(), item) == list.end())
+		list.push_back(item);
+}
+
+void IncrementalActionList::DelAction(IncrementalAction* item)
+{
+	stdalgo::erase(list, item);
+}
+
+void IncrementalActionList::Run()
+{
+	// Actions can be added or removed by the actions we are running.
+	const std::vector<IncrementalAction*> working(list);
+	for (auto* item : working)
+	{
+		if (std::find(list.begin(), list.end(), item) == list.end())
+			continue; // Removed by an earlier action.
+
+		if (!item->Step())
+			DelAction(item);
+	}
+}
@@ -169,7 +169,7 @@ size_t irc::insensitive::operator()(const std::string &s) const
 	return t;
 }
 
-irc::tokenstream::tokenstream(const std::string& msg, size_t start, size_t end)
+irc::tokenstream::tokenstream(std::string_view msg, size_t start, size_t end)
 	: message(msg, start, end)
 {
 }
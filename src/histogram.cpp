@@ -0,0 +1,75 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "inspircd.h"
+
+unsigned int LatencyHistogram::GetBucket(unsigned long long usecs)
+{
+	// Latencies which are shorter than the number of sub-buckets are stored exactly.
+	if (usecs < SUB_BUCKETS)
+		return static_cast<unsigned int>(usecs);
+
+	unsigned int exponent = SUB_BUCKET_BITS;
+	while (exponent < MAX_EXPONENT && (usecs >> (exponent + 1)))
+		exponent++;
+
+	if (usecs >> (exponent + 1))
+		return BUCKETS - 1;
+
+	const unsigned int subbucket = static_cast<unsigned int>(usecs >> (exponent - SUB_BUCKET_BITS)) - SUB_BUCKETS;
+	return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + subbucket;
+}
+
+unsigned long long LatencyHistogram::GetBucketLimit(unsigned int bucket)
+{
+	if (bucket < SUB_BUCKETS)
+		return bucket;
+
+	const unsigned int shift = bucket / SUB_BUCKETS - 1;
+	const unsigned long long lower = static_cast<unsigned long long>(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+	return lower + (1ULL << shift) - 1;
+}
+
+void LatencyHistogram::Add(Duration latency)
+{
+	const auto usecs = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+	buckets[GetBucket(usecs > 0 ? usecs : 0)]++;
+	count++;
+	total += latency;
+	max = std::max(max, latency);
+}
+
+LatencyHistogram::Duration LatencyHistogram::GetPercentile(double percent) const
+{
+	if (!count)
+		return Duration::zero();
+
+	// The rank of the latency which the percentile falls on.
+	const unsigned long rank = std::max(1UL, static_cast<unsigned long>(std::ceil(count * percent / 100)));
+
+	unsigned long seen = 0;
+	for (unsigned int bucket = 0; bucket < BUCKETS; ++bucket)
+	{
+		seen += buckets[bucket];
+		if (seen >= rank)
+		{
+			const Duration limit = std::chrono::microseconds(GetBucketLimit(bucket));
+			return std::min(limit, max);
+		}
+	}
+	return max;
+}
@@ -611,6 +611,9 @@ void InspIRCd::UpdateTime()
 	TIME.tv_sec = tv.tv_sec;
 	TIME.tv_nsec = tv.tv_usec * 1000;
 #endif
+
+	const auto now = std::chrono::steady_clock::now().time_since_epoch();
+	MONOTONIC = std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
 }
 
 void InspIRCd::Run()
@@ -620,6 +623,8 @@ void InspIRCd::Run()
 
 	while (true)
 	{
+		LoopStats.StartPhase(LoopProfiler::PHASE_TIMERS);
+
 		/* Check if there is a config thread which has finished executing but has not yet been freed */
 		if (this->ConfigThread && this->ConfigThread->IsDone())
 		{
@@ -646,7 +651,6 @@ void InspIRCd::Run()
 			if ((TIME.tv_sec % 3600) == 0)
 				FOREACH_MOD(OnGarbageCollect, ());
 
-			Timers.TickTimers(TIME.tv_sec);
 			Users.DoBackgroundUserStuff();
 
 			if ((TIME.tv_sec % 5) == 0)
@@ -656,25 +660,44 @@ void InspIRCd::Run()
 			}
 		}
 
+		/* Timers have a resolution of a millisecond so they are checked
+		 * on every iteration rather than once a second.
+		 */
+		Timers.TickTimers(TIME.tv_sec);
+
 		/* Call the socket engine to wait on the active
 		 * file descriptors. The socket engine has everything's
 		 * descriptors in its list... dns, modules, users,
 		 * servers... so its nice and easy, just one call.
 		 * This will cause any read or write events to be
 		 * dispatched to their handlers.
+		 *
+		 * The wait ends when the next timer is due or the next second starts,
+		 * whichever is sooner, unless there is incremental work to continue.
 		 */
+		int timeout = 0;
+		if (IncrementalActions.IsEmpty())
+			timeout = Timers.GetNextTimeout(1000 - TIME.tv_nsec / 1000000);
+
+		LoopStats.StartPhase(LoopProfiler::PHASE_DISPATCH);
 		SocketEngine::DispatchTrialWrites();
-		SocketEngine::DispatchEvents();
+		SocketEngine::DispatchEvents(timeout);
 
 		/* if any users were quit, take them out */
+		LoopStats.StartPhase(LoopProfiler::PHASE_CULL);
 		GlobalCulls.Apply();
+
+		LoopStats.StartPhase(LoopProfiler::PHASE_ACTIONS);
 		AtomicActions.Run();
+		IncrementalActions.Run();
 
 		if (s_signal)
 		{
 			this->SignalHandler(s_signal);
 			s_signal = 0;
 		}
+
+		LoopStats.EndIteration();
 	}
 }
 
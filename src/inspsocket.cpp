@@ -32,6 +32,9 @@
 #include "inspircd.h"
 #include "iohook.h"
 
+size_t StreamSocket::SendQueue::totalbytes = 0;
+size_t StreamSocket::totalrecvq = 0;
+
 static IOHook* GetNextHook(IOHook* hook)
 {
 	IOHookMiddle* const iohm = IOHookMiddle::ToMiddleHook(hook);
@@ -133,6 +136,11 @@ void StreamSocket::Close(bool writeblock)
 		Close();
 }
 
+StreamSocket::~StreamSocket()
+{
+	totalrecvq -= countedrecvq;
+}
+
 Cullable::Result StreamSocket::Cull()
 {
 	Close();
@@ -163,11 +171,13 @@ void StreamSocket::DoRead()
 	if (result < 0)
 	{
 		SetError("Read Error"); // will not overwrite a better error message
+		CountRecvQ();
 		return;
 	}
 
 	if (recvq.size() > prevrecvqsize)
 		OnDataReady();
+	CountRecvQ();
 }
 
 int StreamSocket::ReadToRecvQ(std::string& rq)
@@ -229,7 +239,7 @@ void StreamSocket::DoWrite()
 
 	SendQueue* psendq = &sendq;
 	IOHook* hook = GetIOHook();
-	while (hook)
+	while (hook && !hook->IsKernelSend())
 	{
 		int rv = hook->OnStreamSocketWrite(this, *psendq);
 		psendq = NULL;
@@ -354,12 +364,36 @@ void StreamSocket::FlushSendQ(SendQueue& sq)
 		}
 }
 
-void StreamSocket::WriteData(const std::string &data)
+void StreamSocket::PauseReading()
+{
+	if (readpaused)
+		return;
+
+	readpaused = true;
+	if (HasFd())
+		SocketEngine::ChangeEventMask(this, FD_WANT_NO_READ);
+}
+
+void StreamSocket::ResumeReading()
+{
+	if (!readpaused)
+		return;
+
+	readpaused = false;
+	if (HasFd())
+	{
+		// Data may have arrived whilst we were paused so we need to try to read
+		// it now rather than waiting for an edge which may never come.
+		SocketEngine::ChangeEventMask(this, FD_WANT_FAST_READ | FD_ADD_TRIAL_READ);
+	}
+}
+
+void StreamSocket::WriteData(const SendQueue::Element& data)
 {
 	if (!HasFd())
 	{
-		ServerInstance->Logs.Log("SOCKET", LOG_DEBUG, "Attempt to write data to dead socket: %s",
-			data.c_str());
+		ServerInstance->Logs.Log("SOCKET", LOG_DEBUG, "Attempt to write data to dead socket: %.*s",
+			static_cast<int>(data.length()), data.data());
 		return;
 	}
 
@@ -457,6 +491,15 @@ void StreamSocket::OnEventHandlerRead()
 	if (!error.empty())
 		return;
 
+	if (readpaused)
+	{
+		// Something (e.g. an I/O hook) wanted to read whilst we are paused. The
+		// socket engine has cleared FD_READ_WILL_BLOCK so the trial read done by
+		// ResumeReading() will pick up whatever is waiting.
+		SocketEngine::ChangeEventMask(this, FD_WANT_NO_READ);
+		return;
+	}
+
 	try
 	{
 		DoRead();
@@ -530,6 +573,12 @@ void StreamSocket::AddIOHook(IOHook* newhook)
 	lasthook->SetNextHook(newhook);
 }
 
+void StreamSocket::PushIOHook(IOHookMiddle* newhook)
+{
+	newhook->SetNextHook(iohook);
+	iohook = newhook;
+}
+
 size_t StreamSocket::GetSendQSize() const
 {
 	size_t ret = sendq.bytes();
@@ -554,8 +603,10 @@ void StreamSocket::SwapInternals(StreamSocket& other)
 	EventHandler::SwapInternals(other);
 	std::swap(closeonempty, other.closeonempty);
 	std::swap(closing, other.closing);
+	std::swap(readpaused, other.readpaused);
 	std::swap(error, other.error);
 	std::swap(iohook, other.iohook);
 	std::swap(recvq, other.recvq);
-	std::swap(sendq, other.sendq);
+	std::swap(countedrecvq, other.countedrecvq);
+	sendq.swap(other.sendq);
 }
@@ -25,6 +25,7 @@
 
 
 #include "inspircd.h"
+#include "utility/linescan.h"
 
 static const char hextable[] = "0123456789abcdef";
 
@@ -114,6 +115,35 @@ std::string Base64ToBin(const std::string& data_str, const char* table)
 	return rv;
 }
 
+namespace
+{
+	insp::linescan::Scanner SelectLineScanner()
+	{
+#ifdef INSPIRCD_LINESCAN_AVX2
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return insp::linescan::FindAVX2;
+#endif
+#ifdef INSPIRCD_LINESCAN_SSE2
+		return insp::linescan::FindSSE2;
+#else
+		return insp::linescan::FindScalar;
+#endif
+	}
+
+	const insp::linescan::Scanner BestLineScanner = SelectLineScanner();
+}
+
+size_t FindLineControl(const char* data, size_t len)
+{
+	return BestLineScanner(data, len);
+}
+
+size_t CleanLine(char* data, size_t len)
+{
+	return insp::linescan::Clean(data, len, BestLineScanner);
+}
+
 bool InspIRCd::TimingSafeCompare(const std::string& one, const std::string& two)
 {
 	if (one.length() != two.length())
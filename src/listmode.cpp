@@ -22,6 +22,44 @@
 #include "inspircd.h"
 #include "listmode.h"
 
+void ListModeBase::ChanData::Changed()
+{
+	// This is shared between all lists so that a list which is destroyed and then
+	// recreated never reuses a generation that a cached result may refer to.
+	static unsigned long lastgeneration = 0;
+	index.generation = ++lastgeneration;
+	indexmap = nullptr;
+}
+
+void ListModeBase::ChanData::RebuildIndex()
+{
+	index.other.clear();
+	index.exact.clear();
+	index.cidr.clear();
+	index.wildcard.clear();
+
+	for (const auto& item : list)
+	{
+		// Anything which is not in the nick!user@host form (e.g. an extban) can
+		// not be indexed. Extbans always have a colon before the first @.
+		const std::string::size_type at = item.mask.find('@');
+		if (at == std::string::npos || item.mask.find(':') < at)
+		{
+			index.other.push_back(&item);
+			continue;
+		}
+
+		const std::string host(item.mask, at + 1);
+		if (host.find('/') != std::string::npos)
+			index.cidr.push_back(&item);
+		else if (host.find_first_of("*?") != std::string::npos)
+			index.wildcard.push_back(&item);
+		else
+			index.exact[host].push_back(&item);
+	}
+	indexmap = national_case_insensitive_map;
+}
+
 ListModeBase::ListModeBase(Module* Creator, const std::string& Name, char modechar, const std::string& eolstr, unsigned int lnum, unsigned int eolnum, bool autotidy)
 	: ModeHandler(Creator, Name, modechar, PARAM_ALWAYS, MODETYPE_CHANNEL, MC_LIST)
 	, listnumeric(lnum)
@@ -33,6 +71,23 @@ ListModeBase::ListModeBase(Module* Creator, const std::string& Name, char modech
 	list = true;
 }
 
+const ListModeBase::MaskIndex* ListModeBase::GetIndex(Channel* channel)
+{
+	ChanData* cd = extItem.Get(channel);
+	if (!cd)
+		return NULL;
+
+	if (cd->indexmap != national_case_insensitive_map)
+	{
+		// Either the list has been modified or the case map the exact host
+		// matches were keyed with has changed.
+		if (cd->indexmap)
+			cd->Changed();
+		cd->RebuildIndex();
+	}
+	return &cd->index;
+}
+
 void ListModeBase::DisplayList(User* user, Channel* channel)
 {
 	ChanData* cd = extItem.Get(channel);
@@ -161,6 +216,7 @@ ModeAction ListModeBase::OnModeChange(User* source, User*, Channel* channel, Mod
 		{
 			// Make one
 			cd = new ChanData;
+			cd->Changed();
 			extItem.Set(channel, cd);
 		}
 
@@ -198,6 +254,7 @@ ModeAction ListModeBase::OnModeChange(User* source, User*, Channel* channel, Mod
 		{
 			// And now add the mask onto the list...
 			cd->list.emplace_back(change.param, change.set_by.value_or(source->nick), change.set_at.value_or(ServerInstance->Time()));
+			cd->Changed();
 			return MODEACTION_ALLOW;
 		}
 		else
@@ -216,6 +273,7 @@ ModeAction ListModeBase::OnModeChange(User* source, User*, Channel* channel, Mod
 				if (change.param == it->mask)
 				{
 					stdalgo::vector::swaperase(cd->list, it);
+					cd->Changed();
 					return MODEACTION_ALLOW;
 				}
 			}
@@ -0,0 +1,209 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "inspircd.h"
+
+#ifndef _WIN32
+# include <cxxabi.h>
+# include <dlfcn.h>
+# ifdef __GLIBC__
+#  include <link.h>
+# endif
+#endif
+
+namespace
+{
+	double ToMillis(const LoopProfiler::Duration& duration)
+	{
+		return std::chrono::duration<double, std::milli>(duration).count();
+	}
+
+	std::string Demangle(const char* name)
+	{
+#ifdef _WIN32
+		return name;
+#else
+		int status;
+		char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+		if (!demangled)
+			return name;
+
+		std::string ret(demangled);
+		free(demangled);
+		return ret;
+#endif
+	}
+}
+
+std::string LoopProfiler::DescribeType(TypeId type)
+{
+#ifdef INSPIRCD_ENABLE_RTTI
+	const auto* info = static_cast<const std::type_info*>(type);
+	std::string name = Demangle(info->name());
+	const void* addr = info;
+#else
+	std::string name;
+	const void* addr = type;
+#endif
+
+	// The file which contains the type information says which module the type is from.
+	std::string file;
+#ifdef _WIN32
+	HMODULE module;
+	char path[MAX_PATH];
+	if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, static_cast<LPCSTR>(addr), &module)
+		&& GetModuleFileNameA(module, path, sizeof(path)))
+		file = FileSystem::GetFileName(path);
+#else
+	Dl_info dlinfo;
+# ifdef __GLIBC__
+	void* symbol = nullptr;
+	if (dladdr1(addr, &dlinfo, &symbol, RTLD_DL_SYMENT))
+# else
+	if (dladdr(addr, &dlinfo))
+# endif
+	{
+		if (dlinfo.dli_fname)
+			file = FileSystem::GetFileName(dlinfo.dli_fname);
+
+# if !defined INSPIRCD_ENABLE_RTTI && defined __GLIBC__
+		// Only vtables which are exported have a symbol so make sure that the nearest symbol
+		// is actually the vtable rather than something which comes before it.
+		const auto* sym = static_cast<const ElfW(Sym)*>(symbol);
+		const auto symaddr = reinterpret_cast<uintptr_t>(dlinfo.dli_saddr);
+		const auto vptr = reinterpret_cast<uintptr_t>(addr);
+		if (sym && dlinfo.dli_sname && !strncmp(dlinfo.dli_sname, "_ZTV", 4) && vptr < symaddr + sym->st_size)
+			name = Demangle(dlinfo.dli_sname + 4);
+# endif
+	}
+#endif
+
+	if (name.empty())
+		return file.empty() ? "unknown type" : file;
+	if (file.empty())
+		return name;
+	return name + " in " + file;
+}
+
+const char* LoopProfiler::GetPhaseName(Phase phase)
+{
+	switch (phase)
+	{
+		case PHASE_TIMERS:
+			return "timers";
+		case PHASE_WAIT:
+			return "wait";
+		case PHASE_DISPATCH:
+			return "dispatch";
+		case PHASE_CULL:
+			return "cull";
+		case PHASE_ACTIONS:
+			return "actions";
+		default:
+			return "busy";
+	}
+}
+
+void LoopProfiler::StartPhase(Phase newphase)
+{
+	const TimePoint now = std::chrono::steady_clock::now();
+	if (phase != PHASE_COUNT)
+		phasetimes[phase] += now - phasestart;
+
+	phase = newphase;
+	phasestart = now;
+}
+
+void LoopProfiler::EndIteration()
+{
+	StartPhase(PHASE_COUNT);
+
+	Duration busy{};
+	for (size_t idx = 0; idx < PHASE_COUNT; ++idx)
+	{
+		window[idx].Add(phasetimes[idx]);
+		if (idx != PHASE_WAIT)
+			busy += phasetimes[idx];
+	}
+	window[PHASE_COUNT].Add(busy);
+
+	if (IsWatching() && busy > budget)
+		ReportStall(busy);
+
+	phasetimes.fill(Duration::zero());
+	activities.clear();
+	budget = std::chrono::milliseconds(ServerInstance->Config->LoopBudget);
+
+	if (phasestart - windowstart >= WINDOW)
+	{
+		lastwindow = window;
+		for (auto& histogram : window)
+			histogram.Reset();
+		windowstart = phasestart;
+	}
+}
+
+void LoopProfiler::ReportStall(const Duration& busy)
+{
+	stalls++;
+
+	std::string phases;
+	for (size_t idx = 0; idx < PHASE_COUNT; ++idx)
+	{
+		if (idx == PHASE_WAIT)
+			continue;
+
+		if (!phases.empty())
+			phases.append(", ");
+		phases.append(InspIRCd::Format("%s %.1fms", GetPhaseName(static_cast<Phase>(idx)), ToMillis(phasetimes[idx])));
+	}
+
+	const std::string message = InspIRCd::Format("Main loop iteration took %.1fms which is longer than the budget of %.1fms (%s)",
+		ToMillis(busy), ToMillis(budget), phases.c_str());
+	ServerInstance->Logs.Log("LOOP", LOG_DEFAULT, message);
+
+	for (const auto& activity : activities)
+	{
+		std::string name = activity.name;
+		if (activity.fd >= 0)
+		{
+			// Finding the user who owns the socket is too slow to do for every socket event
+			// so it is only done when reporting a stall.
+			name.append(InspIRCd::Format(" on fd %d", activity.fd));
+			for (auto* user : ServerInstance->Users.GetLocalUsers())
+			{
+				if (user->eh.GetFd() == activity.fd)
+				{
+					name.append(" (" + user->GetFullRealHost() + ")");
+					break;
+				}
+			}
+		}
+
+		ServerInstance->Logs.Log("LOOP", LOG_DEFAULT, "  %s: %s took %.1fms", GetPhaseName(activity.phase),
+			name.c_str(), ToMillis(activity.time));
+	}
+
+	if (activities.empty())
+		ServerInstance->SNO.WriteToSnoMask('p', message);
+	else
+	{
+		const Activity& slowest = activities.front();
+		ServerInstance->SNO.WriteToSnoMask('p', "%s; slowest was %s (%.1fms)", message.c_str(), slowest.name.c_str(),
+			ToMillis(slowest.time));
+	}
+}
@@ -212,10 +212,25 @@ ModeAction PrefixMode::OnModeChange(User* source, User*, Channel* chan, Modes::C
 
 void PrefixMode::Update(unsigned int rank, unsigned int setrank, unsigned int unsetrank, bool selfrm)
 {
+	const bool rankchanged = (prefixrank != rank);
 	prefixrank = rank;
 	ranktoset = setrank;
 	ranktounset = unsetrank;
 	selfremove = selfrm;
+
+	if (!rankchanged)
+		return;
+
+	// Members who have this mode may now belong in a different place in the rank ordered
+	// member lists of their channels.
+	for (const auto& [_, chan] : ServerInstance->chanlist)
+	{
+		for (const auto& [__, memb] : chan->GetUsers())
+		{
+			if (memb->HasMode(this))
+				chan->UpdateRank(memb);
+		}
+	}
 }
 
 ModeAction ParamModeBase::OnModeChange(User* source, User*, Channel* chan, Modes::Change& change)
@@ -119,6 +119,7 @@ bool ModuleManager::Load(const std::string& modname, bool defer)
 
 	FOREACH_MOD(OnLoadModule, (newmod));
 	PrioritizeHooks();
+	Channel::InvalidateBanCache();
 	return true;
 }
 
@@ -74,8 +74,17 @@ std::string Module::GetPropertyString() const
 	return propstr;
 }
 
+HookTimer* HookTimer::current = nullptr;
+
+void HookTimer::OnDetach(const Module* mod, Implementation hookid)
+{
+	if (current && current->module == mod && current->hook == hookid)
+		current->detached = true;
+}
+
 void Module::DetachEvent(Implementation i)
 {
+	HookTimer::OnDetach(this, i);
 	ServerInstance->Modules.Detach(i, this);
 }
 
@@ -121,6 +130,7 @@ ModResult	Module::OnCheckKey(User*, Channel*, const std::string&) { DetachEvent(
 ModResult	Module::OnCheckLimit(User*, Channel*) { DetachEvent(I_OnCheckLimit); return MOD_RES_PASSTHRU; }
 ModResult	Module::OnCheckChannelBan(User*, Channel*) { DetachEvent(I_OnCheckChannelBan); return MOD_RES_PASSTHRU; }
 ModResult	Module::OnCheckBan(User*, Channel*, const std::string&) { DetachEvent(I_OnCheckBan); return MOD_RES_PASSTHRU; }
+void		Module::OnGetBanHosts(User*, std::vector<std::string>&) { DetachEvent(I_OnGetBanHosts); }
 ModResult	Module::OnPreChangeHost(LocalUser*, const std::string&) { DetachEvent(I_OnPreChangeHost); return MOD_RES_PASSTHRU; }
 ModResult	Module::OnPreChangeRealName(LocalUser*, const std::string&) { DetachEvent(I_OnPreChangeRealName); return MOD_RES_PASSTHRU; }
 ModResult	Module::OnPreTopicChange(User*, Channel*, const std::string&) { DetachEvent(I_OnPreTopicChange); return MOD_RES_PASSTHRU; }
@@ -382,6 +392,7 @@ void ModuleManager::DoSafeUnload(Module* mod)
 	// they pass execution to the soon to be unloaded module, it will happen now,
 	// i.e. before we unregister the services of the module being unloaded
 	FOREACH_MOD(OnUnloadModule, (mod));
+	Channel::InvalidateBanCache();
 
 	std::map<std::string, Module*>::iterator modfind = Modules.find(mod->ModuleSourceFile);
 
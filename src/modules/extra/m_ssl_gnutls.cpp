@@ -40,7 +40,9 @@
 /// $PackageInfo: require_system("ubuntu") gnutls-bin libgnutls-dev pkg-config
 
 #include "inspircd.h"
+#include "modules/reload.h"
 #include "modules/ssl.h"
+#include "modules/stats.h"
 
 #include <gnutls/gnutls.h>
 #include <gnutls/crypto.h>
@@ -63,6 +65,11 @@ enum issl_status { ISSL_NONE, ISSL_HANDSHAKING, ISSL_HANDSHAKEN };
 #define INSPIRCD_GNUTLS_HAS_CORK
 #endif
 
+#if INSPIRCD_GNUTLS_HAS_VERSION(3, 7, 3) && defined __linux__
+#define INSPIRCD_GNUTLS_HAS_KTLS
+#include <gnutls/socket.h>
+#endif
+
 static Module* thismod;
 
 namespace GnuTLS
@@ -462,6 +469,260 @@ namespace GnuTLS
 		int ret() const { return retval; }
 	};
 
+	class SessionStore
+	{
+	 public:
+		/** Statistics about session resumption. */
+		struct Stats
+		{
+			size_t size;
+			size_t maxsize;
+			unsigned long fullhandshakes;
+			unsigned long resumedhandshakes;
+			unsigned long hits;
+			unsigned long misses;
+			unsigned long evictions;
+		};
+
+	 private:
+		/** A session which has been cached so that it can be resumed. */
+		struct Entry
+		{
+			/** The name of the profile which created the session followed by the identifier of the session. */
+			std::string id;
+
+			/** The session parameters as serialized by GnuTLS. */
+			std::string data;
+
+			/** The time at which the session can no longer be resumed. */
+			time_t expires;
+		};
+
+		typedef std::list<Entry> EntryList;
+
+		/** The cached sessions in the order they were created. */
+		EntryList sessions;
+
+		/** The cached sessions indexed by their identifier. */
+		std::unordered_map<std::string, EntryList::iterator> index;
+
+		/** The master keys that session tickets are encrypted with indexed by profile name. GnuTLS derives
+		 * the actual ticket keys from these and rotates them every session lifetime by itself.
+		 */
+		std::map<std::string, std::string> keys;
+
+		/** The maximum number of sessions to cache. */
+		size_t maxsize = 0;
+
+		/** The number of seconds a session can be resumed for. */
+		unsigned long lifetime = 3600;
+
+		/** Whether session tickets are issued. */
+		bool tickets = true;
+
+		/** Statistics about session resumption. */
+		unsigned long fullhandshakes = 0;
+		unsigned long resumedhandshakes = 0;
+		unsigned long hits = 0;
+		unsigned long misses = 0;
+		unsigned long evictions = 0;
+
+		void RemoveEntry(EntryList::iterator it)
+		{
+			index.erase(it->id);
+			sessions.erase(it);
+		}
+
+		void Trim()
+		{
+			while (sessions.size() > maxsize)
+			{
+				RemoveEntry(sessions.begin());
+				evictions++;
+			}
+		}
+
+		void Insert(const std::string& id, const std::string& data, time_t expires)
+		{
+			if (!maxsize)
+				return;
+
+			auto it = index.find(id);
+			if (it != index.end())
+				RemoveEntry(it->second);
+
+			sessions.push_back({ id, data, expires });
+			index[id] = std::prev(sessions.end());
+			Trim();
+		}
+
+		static std::string GetId(void* ptr, const gnutls_datum_t& key)
+		{
+			std::string id(*static_cast<const std::string*>(ptr));
+			id.push_back('\0');
+			id.append(reinterpret_cast<const char*>(key.data), key.size);
+			return id;
+		}
+
+		static int OnStore(void* ptr, gnutls_datum_t key, gnutls_datum_t data);
+		static gnutls_datum_t OnRetrieve(void* ptr, gnutls_datum_t key);
+		static int OnRemove(void* ptr, gnutls_datum_t key);
+
+	 public:
+		~SessionStore()
+		{
+			for (auto& [_, key] : keys)
+				gnutls_memset(&key[0], 0, key.size());
+		}
+
+		/** Changes the settings of the store. */
+		void Configure(size_t size, unsigned long life, bool issuetickets)
+		{
+			maxsize = size;
+			lifetime = life;
+			tickets = issuetickets;
+			Trim();
+		}
+
+		/** Enables session resumption on a server session.
+		 * @param sess The session to enable resumption on.
+		 * @param profilename The name of the profile which created the session. Must outlive the session.
+		 */
+		void SetupSession(gnutls_session_t sess, const std::string& profilename)
+		{
+			gnutls_db_set_ptr(sess, const_cast<std::string*>(&profilename));
+			gnutls_db_set_store_function(sess, OnStore);
+			gnutls_db_set_retrieve_function(sess, OnRetrieve);
+			gnutls_db_set_remove_function(sess, OnRemove);
+			gnutls_db_set_cache_expiration(sess, lifetime);
+			if (!tickets)
+				return;
+
+			// Each profile has its own key so that a ticket can not be used to skip the checks of another profile.
+			std::string& key = keys[profilename];
+			if (key.empty())
+			{
+				gnutls_datum_t newkey;
+				int ret = gnutls_session_ticket_key_generate(&newkey);
+				if (ret < 0)
+				{
+					ServerInstance->Logs.Log(MODNAME, LOG_DEFAULT, "Unable to generate a session ticket key for profile \"%s\": %s", profilename.c_str(), gnutls_strerror(ret));
+					keys.erase(profilename);
+					return;
+				}
+
+				key.assign(reinterpret_cast<const char*>(newkey.data), newkey.size);
+				gnutls_memset(newkey.data, 0, newkey.size);
+				gnutls_free(newkey.data);
+			}
+
+			gnutls_datum_t datum = { reinterpret_cast<unsigned char*>(&key[0]), static_cast<unsigned int>(key.size()) };
+			gnutls_session_ticket_enable_server(sess, &datum);
+		}
+
+		/** Records that a server handshake has completed. */
+		void CountHandshake(bool resumed)
+		{
+			if (resumed)
+				resumedhandshakes++;
+			else
+				fullhandshakes++;
+		}
+
+		/** Removes expired sessions. */
+		void Expire(time_t now)
+		{
+			// Sessions are cached in the order they were created so the expired ones are at the start.
+			while (!sessions.empty() && sessions.front().expires <= now)
+				RemoveEntry(sessions.begin());
+		}
+
+		/** Retrieves statistics about session resumption. */
+		Stats GetStats() const
+		{
+			return { sessions.size(), maxsize, fullhandshakes, resumedhandshakes, hits, misses, evictions };
+		}
+
+		/** Serializes the ticket keys and cached sessions so they can be restored after a reload. */
+		std::string Serialize() const
+		{
+			std::string data;
+			for (const auto& [profilename, key] : keys)
+				data.append("key ").append(BinToBase64(profilename)).append(" ").append(BinToBase64(key)).push_back('\n');
+
+			for (const auto& entry : sessions)
+				data.append("session ").append(BinToBase64(entry.id)).append(" ").append(BinToBase64(entry.data)).append(" ").append(ConvToStr(entry.expires)).push_back('\n');
+			return data;
+		}
+
+		/** Restores the ticket keys and cached sessions from data created by Serialize(). */
+		void Unserialize(const std::string& data)
+		{
+			irc::sepstream lines(data, '\n');
+			for (std::string line; lines.GetToken(line); )
+			{
+				irc::spacesepstream tokens(line);
+				std::string type;
+				std::string first;
+				std::string second;
+				if (!tokens.GetToken(type) || !tokens.GetToken(first) || !tokens.GetToken(second))
+					continue;
+
+				if (type == "key")
+				{
+					keys[Base64ToBin(first)] = Base64ToBin(second);
+				}
+				else if (type == "session")
+				{
+					std::string expires;
+					if (tokens.GetToken(expires))
+						Insert(Base64ToBin(first), Base64ToBin(second), ConvToNum<time_t>(expires));
+				}
+			}
+		}
+	};
+
+	/** The session resumption state of this module. */
+	static std::unique_ptr<SessionStore> sessionstore;
+
+	int SessionStore::OnStore(void* ptr, gnutls_datum_t key, gnutls_datum_t data)
+	{
+		sessionstore->Insert(GetId(ptr, key), std::string(reinterpret_cast<const char*>(data.data), data.size), ServerInstance->Time() + sessionstore->lifetime);
+		return 0;
+	}
+
+	gnutls_datum_t SessionStore::OnRetrieve(void* ptr, gnutls_datum_t key)
+	{
+		gnutls_datum_t data = { NULL, 0 };
+		auto it = sessionstore->index.find(GetId(ptr, key));
+		if (it == sessionstore->index.end())
+		{
+			sessionstore->misses++;
+			return data;
+		}
+
+		// GnuTLS takes ownership of the returned data.
+		const std::string& session = it->second->data;
+		data.data = static_cast<unsigned char*>(gnutls_malloc(session.size()));
+		if (!data.data)
+			return data;
+
+		memcpy(data.data, session.data(), session.size());
+		data.size = session.size();
+		sessionstore->hits++;
+		return data;
+	}
+
+	int SessionStore::OnRemove(void* ptr, gnutls_datum_t key)
+	{
+		auto it = sessionstore->index.find(GetId(ptr, key));
+		if (it == sessionstore->index.end())
+			return -1;
+
+		sessionstore->RemoveEntry(it->second);
+		return 0;
+	}
+
 	class Profile
 	{
 		/** Name of this profile
@@ -492,6 +753,10 @@ namespace GnuTLS
 		 */
 		const bool requestclientcert;
 
+		/** True if records should be handled by the kernel when possible
+		 */
+		const bool ktls;
+
 		static std::string ReadFile(const std::string& filename)
 		{
 			FileReader reader(filename);
@@ -544,6 +809,7 @@ namespace GnuTLS
 
 			unsigned int outrecsize;
 			bool requestclientcert;
+			bool ktls;
 
 			Config(const std::string& profilename, std::shared_ptr<ConfigTag> tag)
 				: name(profilename)
@@ -554,6 +820,11 @@ namespace GnuTLS
 				, mindh(tag->getUInt("mindhbits", 1024))
 				, hashstr(tag->getString("hash", "sha256", 1))
 				, requestclientcert(tag->getBool("requestclientcert", true))
+#ifdef INSPIRCD_GNUTLS_HAS_KTLS
+				, ktls(tag->getBool("ktls"))
+#else
+				, ktls(false)
+#endif
 			{
 				// Load trusted CA and revocation list, if set
 				std::string filename = tag->getString("cafile");
@@ -583,6 +854,7 @@ namespace GnuTLS
 			, priority(config.priostr)
 			, outrecsize(config.outrecsize)
 			, requestclientcert(config.requestclientcert)
+			, ktls(config.ktls)
 		{
 			x509cred.SetDH(config.dh);
 			x509cred.SetCA(config.ca, config.crl);
@@ -604,6 +876,7 @@ namespace GnuTLS
 		X509Credentials& GetX509Credentials() { return x509cred; }
 		gnutls_digest_algorithm_t GetHash() const { return hash.get(); }
 		unsigned int GetOutgoingRecordSize() const { return outrecsize; }
+		bool UseKernelTLS() const { return ktls; }
 	};
 }
 
@@ -666,6 +939,11 @@ class GnuTLSIOHook : public SSLIOHook
 			this->status = ISSL_HANDSHAKEN;
 
 			VerifyCertificate();
+			CheckKernelTLS();
+
+			// Only server sessions have a session cache.
+			if (gnutls_db_get_ptr(this->sess))
+				GnuTLS::sessionstore->CountHandshake(gnutls_session_is_resumed(this->sess));
 
 			// Finish writing, if any left
 			SocketEngine::ChangeEventMask(user, FD_WANT_POLL_READ | FD_WANT_NO_WRITE | FD_ADD_TRIAL_WRITE);
@@ -674,6 +952,20 @@ class GnuTLSIOHook : public SSLIOHook
 		}
 	}
 
+	// Steps out of the send path if GnuTLS handed it over to the kernel. Reads always go
+	// through GnuTLS as the kernel hands alerts, key updates and session tickets back to
+	// userspace as control messages which a plain recv() would fail on.
+	void CheckKernelTLS()
+	{
+#ifdef INSPIRCD_GNUTLS_HAS_KTLS
+		const gnutls_transport_ktls_enable_flags_t flags = gnutls_transport_is_ktls_enabled(sess);
+		kernelsend = (flags & GNUTLS_KTLS_SEND);
+
+		if (flags)
+			ServerInstance->Logs.Log(MODNAME, LOG_DEBUG, "Session %p is using kernel TLS (send: %s, receive: %s)", (void*)sess, kernelsend ? "yes" : "no", (flags & GNUTLS_KTLS_RECV) ? "yes" : "no");
+#endif
+	}
+
 	void VerifyCertificate()
 	{
 		unsigned int certstatus;
@@ -910,10 +1202,21 @@ info_done_dealloc:
 		: SSLIOHook(hookprov)
 	{
 		gnutls_init(&sess, flags);
-		gnutls_transport_set_ptr(sess, reinterpret_cast<gnutls_transport_ptr_t>(sock));
-		gnutls_transport_set_vec_push_function(sess, VectorPush);
-		gnutls_transport_set_pull_function(sess, gnutls_pull_wrapper);
+		gnutls_session_set_ptr(sess, sock);
+		if (GetProfile().UseKernelTLS())
+		{
+			// GnuTLS can only hand the session keys to the kernel if it uses the socket itself.
+			gnutls_transport_set_int(sess, sock->GetFd());
+		}
+		else
+		{
+			gnutls_transport_set_ptr(sess, reinterpret_cast<gnutls_transport_ptr_t>(sock));
+			gnutls_transport_set_vec_push_function(sess, VectorPush);
+			gnutls_transport_set_pull_function(sess, gnutls_pull_wrapper);
+		}
 		GetProfile().SetupSession(sess);
+		if (flags == GNUTLS_SERVER)
+			GnuTLS::sessionstore->SetupSession(sess, GetProfile().GetName());
 
 		sock->AddIOHook(this);
 		Handshake(sock);
@@ -1063,7 +1366,7 @@ int GnuTLS::X509Credentials::cert_callback(gnutls_session_t sess, const gnutls_d
 	st->cert_type = GNUTLS_CRT_X509;
 	st->key_type = GNUTLS_PRIVKEY_X509;
 
-	StreamSocket* sock = reinterpret_cast<StreamSocket*>(gnutls_transport_get_ptr(sess));
+	StreamSocket* sock = static_cast<StreamSocket*>(gnutls_session_get_ptr(sess));
 	GnuTLS::X509Credentials& cred = static_cast<GnuTLSIOHook*>(sock->GetModHook(thismod))->GetProfile().GetX509Credentials();
 
 	st->ncerts = cred.certs.size();
@@ -1110,7 +1413,11 @@ GnuTLS::Profile& GnuTLSIOHook::GetProfile()
 	return static_cast<GnuTLSIOHookProvider*>(hookprov)->GetProfile();
 }
 
-class ModuleSSLGnuTLS : public Module
+class ModuleSSLGnuTLS
+	: public Module
+	, public ReloadModule::EventListener
+	, public Stats::EventListener
+	, public Timer
 {
 	typedef std::vector<reference<GnuTLSIOHookProvider> > ProfileList;
 
@@ -1169,19 +1476,26 @@ class ModuleSSLGnuTLS : public Module
  public:
 	ModuleSSLGnuTLS()
 		: Module(VF_VENDOR, "Allows TLS encrypted connections using the GnuTLS library.")
+		, ReloadModule::EventListener(this)
+		, Stats::EventListener(this)
+		, Timer(60, true)
 	{
 		thismod = this;
+		GnuTLS::sessionstore = std::make_unique<GnuTLS::SessionStore>();
 	}
 
 	void init() override
 	{
 		ServerInstance->Logs.Log(MODNAME, LOG_DEFAULT, "GnuTLS lib version %s module was compiled for " GNUTLS_VERSION, gnutls_check_version(NULL));
 		ServerInstance->GenRandom = GnuTLS::GenRandom;
+		ServerInstance->Timers.AddTimer(this);
 	}
 
 	void ReadConfig(ConfigStatus& status) override
 	{
 		auto tag = ServerInstance->Config->ConfValue("gnutls");
+		GnuTLS::sessionstore->Configure(tag->getUInt("sessioncachesize", 20480), tag->getDuration("sessionlifetime", 3600, 60), tag->getBool("sessiontickets", true));
+		GnuTLS::sessionstore->Expire(ServerInstance->Time());
 		if (status.initial || tag->getBool("onrehash", true))
 			ReadProfiles();
 	}
@@ -1205,6 +1519,7 @@ class ModuleSSLGnuTLS : public Module
 	~ModuleSSLGnuTLS() override
 	{
 		ServerInstance->GenRandom = &InspIRCd::DefaultGenRandom;
+		GnuTLS::sessionstore.reset();
 	}
 
 	void OnCleanup(ExtensionItem::ExtensibleType type, Extensible* item) override
@@ -1229,6 +1544,40 @@ class ModuleSSLGnuTLS : public Module
 			return MOD_RES_DENY;
 		return MOD_RES_PASSTHRU;
 	}
+
+	bool Tick(time_t currtime) override
+	{
+		GnuTLS::sessionstore->Expire(currtime);
+		return true;
+	}
+
+	ModResult OnStats(Stats::Context& stats) override
+	{
+		if (stats.GetSymbol() != 'z')
+			return MOD_RES_PASSTHRU;
+
+		const GnuTLS::SessionStore::Stats sessionstats = GnuTLS::sessionstore->GetStats();
+		const unsigned long handshakes = sessionstats.fullhandshakes + sessionstats.resumedhandshakes;
+		stats.AddRow(249, InspIRCd::Format("GnuTLS sessions: %zu/%zu cached; Handshakes: %lu; Resumed: %lu (%lu%%); Cache hits: %lu; Cache misses: %lu; Evictions: %lu",
+			sessionstats.size, sessionstats.maxsize, handshakes, sessionstats.resumedhandshakes, handshakes ? sessionstats.resumedhandshakes * 100 / handshakes : 0,
+			sessionstats.hits, sessionstats.misses, sessionstats.evictions));
+		return MOD_RES_PASSTHRU;
+	}
+
+	void OnReloadModuleSave(Module* mod, ReloadModule::CustomData& cd) override
+	{
+		// Keep the ticket keys and cached sessions so clients can still resume after a reload.
+		if (mod == this)
+			cd.add(this, new std::string(GnuTLS::sessionstore->Serialize()));
+	}
+
+	void OnReloadModuleRestore(Module* mod, void* data) override
+	{
+		std::string* serialized = static_cast<std::string*>(data);
+		GnuTLS::sessionstore->Unserialize(*serialized);
+		gnutls_memset(&(*serialized)[0], 0, serialized->size());
+		delete serialized;
+	}
 };
 
 MODULE_INIT(ModuleSSLGnuTLS)
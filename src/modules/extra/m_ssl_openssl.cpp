@@ -41,11 +41,23 @@
 
 #include "inspircd.h"
 #include "iohook.h"
+#include "modules/reload.h"
 #include "modules/ssl.h"
+#include "modules/stats.h"
+#include "threadsocket.h"
 
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include <openssl/dh.h>
+#include <openssl/rand.h>
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+# include <openssl/core_names.h>
+typedef EVP_MAC_CTX TicketMACContext;
+#else
+# include <openssl/hmac.h>
+typedef HMAC_CTX TicketMACContext;
+#endif
 
 #ifdef _WIN32
 # pragma comment(lib, "ssleay32.lib")
@@ -54,9 +66,10 @@
 
 enum issl_status { ISSL_NONE, ISSL_HANDSHAKING, ISSL_OPEN };
 
-static bool SelfSigned = false;
 static int exdataindex;
 
+class OpenSSLIOHook;
+
 char* get_error()
 {
 	return ERR_error_string(ERR_get_error(), NULL);
@@ -64,6 +77,10 @@ char* get_error()
 
 static int OnVerify(int preverify_ok, X509_STORE_CTX* ctx);
 static void StaticSSLInfoCallback(const SSL* ssl, int where, int rc);
+static int OnNewSession(SSL* ssl, SSL_SESSION* session);
+static SSL_SESSION* OnGetSession(SSL* ssl, const unsigned char* id, int len, int* copy);
+static void OnRemoveSession(SSL_CTX* ctx, SSL_SESSION* session);
+static int OnTicketKey(SSL* ssl, unsigned char* name, unsigned char* iv, EVP_CIPHER_CTX* cctx, TicketMACContext* hctx, int enc);
 
 namespace OpenSSL
 {
@@ -103,6 +120,336 @@ namespace OpenSSL
 		}
 	};
 
+	/** A key which session tickets are encrypted with. */
+	struct TicketKey final
+	{
+		/** The name which identifies tickets encrypted with this key. */
+		unsigned char name[16];
+
+		/** The key used to encrypt tickets. */
+		unsigned char aeskey[32];
+
+		/** The key used to authenticate tickets. */
+		unsigned char hmackey[32];
+
+		/** The time at which this key was created. */
+		time_t created;
+	};
+
+	/** Session resumption state which is shared by all profiles so that it is kept across rehashes. */
+	class SessionStore final
+	{
+	 public:
+		/** Statistics about session resumption. */
+		struct Stats final
+		{
+			size_t size;
+			size_t maxsize;
+			unsigned long fullhandshakes;
+			unsigned long resumedhandshakes;
+			unsigned long hits;
+			unsigned long misses;
+			unsigned long evictions;
+		};
+
+	 private:
+		/** A session which has been cached so that it can be resumed. */
+		struct Entry final
+		{
+			/** The identifier of the session. */
+			std::string id;
+
+			/** The session itself. The cache holds a reference to it. */
+			SSL_SESSION* session;
+		};
+
+		typedef std::list<Entry> EntryList;
+
+		/** Protects the members below as sessions are created and resumed on handshake threads. */
+		mutable std::mutex mutex;
+
+		/** The cached sessions in the order they were created. */
+		EntryList sessions;
+
+		/** The cached sessions indexed by their identifier. */
+		std::unordered_map<std::string, EntryList::iterator> index;
+
+		/** The keys that session tickets are encrypted with, newest first. */
+		std::deque<TicketKey> keys;
+
+		/** The maximum number of sessions to cache. */
+		size_t maxsize = 0;
+
+		/** The number of seconds a session can be resumed for. */
+		unsigned long lifetime = 3600;
+
+		/** Whether session tickets are issued. */
+		bool tickets = true;
+
+		/** Statistics about session resumption. */
+		unsigned long fullhandshakes = 0;
+		unsigned long resumedhandshakes = 0;
+		unsigned long hits = 0;
+		unsigned long misses = 0;
+		unsigned long evictions = 0;
+
+		// Must be called with the mutex held.
+		void RemoveEntry(EntryList::iterator it)
+		{
+			index.erase(it->id);
+			SSL_SESSION_free(it->session);
+			sessions.erase(it);
+		}
+
+		// Must be called with the mutex held.
+		void Trim()
+		{
+			while (sessions.size() > maxsize)
+			{
+				RemoveEntry(sessions.begin());
+				evictions++;
+			}
+		}
+
+		// Must be called with the mutex held. Takes over the reference to the session if it returns true.
+		bool Insert(SSL_SESSION* session)
+		{
+			unsigned int idlen;
+			const unsigned char* id = SSL_SESSION_get_id(session, &idlen);
+			if (!maxsize || !idlen)
+				return false;
+
+			std::string key(reinterpret_cast<const char*>(id), idlen);
+			auto it = index.find(key);
+			if (it != index.end())
+				RemoveEntry(it->second);
+
+			sessions.push_back({ key, session });
+			index[key] = std::prev(sessions.end());
+			Trim();
+			return true;
+		}
+
+	 public:
+		~SessionStore()
+		{
+			for (const auto& entry : sessions)
+				SSL_SESSION_free(entry.session);
+			for (auto& key : keys)
+				OPENSSL_cleanse(&key, sizeof(key));
+		}
+
+		/** Changes the settings of the store. Called on the main thread. */
+		void Configure(size_t size, unsigned long life, bool issuetickets)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			maxsize = size;
+			lifetime = life;
+			tickets = issuetickets;
+			Trim();
+		}
+
+		/** Retrieves the number of seconds a session can be resumed for. Called on the main thread. */
+		unsigned long GetLifetime() const { return lifetime; }
+
+		/** Determines whether session tickets are issued. Called on the main thread. */
+		bool IssueTickets() const { return tickets; }
+
+		/** Adds a newly created session to the cache.
+		 * @return 1 if the cache took over the reference to the session; otherwise, 0.
+		 */
+		int Add(SSL_SESSION* session)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return Insert(session) ? 1 : 0;
+		}
+
+		/** Looks up a session in the cache. The caller is given a reference to the session which it
+		 * must free. This is taken whilst the lock is held as the session may otherwise be freed by
+		 * another thread before the caller gets to it.
+		 */
+		SSL_SESSION* Get(const unsigned char* id, int idlen)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = index.find(std::string(reinterpret_cast<const char*>(id), idlen));
+			if (it == index.end())
+			{
+				misses++;
+				return nullptr;
+			}
+
+			hits++;
+			SSL_SESSION_up_ref(it->second->session);
+			return it->second->session;
+		}
+
+		/** Removes a session which can no longer be resumed from the cache. */
+		void Remove(SSL_SESSION* session)
+		{
+			unsigned int idlen;
+			const unsigned char* id = SSL_SESSION_get_id(session, &idlen);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = index.find(std::string(reinterpret_cast<const char*>(id), idlen));
+			if (it != index.end() && it->second->session == session)
+				RemoveEntry(it->second);
+		}
+
+		/** Records that a server handshake has completed. */
+		void CountHandshake(bool resumed)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (resumed)
+				resumedhandshakes++;
+			else
+				fullhandshakes++;
+		}
+
+		/** Retrieves the key that new session tickets are encrypted with.
+		 * @return True if a key was retrieved; otherwise, false.
+		 */
+		bool GetCurrentKey(TicketKey& key) const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (keys.empty())
+				return false;
+
+			key = keys.front();
+			return true;
+		}
+
+		/** Retrieves the key that a session ticket was encrypted with.
+		 * @return 0 if the key is unknown, 1 if it is the current key, or 2 if the ticket should be renewed.
+		 */
+		int FindKey(const unsigned char* name, TicketKey& key) const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto it = keys.begin(); it != keys.end(); ++it)
+			{
+				if (!memcmp(it->name, name, sizeof(it->name)))
+				{
+					key = *it;
+					return it == keys.begin() ? 1 : 2;
+				}
+			}
+			return 0;
+		}
+
+		/** Removes expired sessions and rotates the ticket keys. Called on the main thread. */
+		void Expire(time_t now)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			// Sessions are cached in the order they were created so the expired ones are at the start.
+			while (!sessions.empty())
+			{
+				SSL_SESSION* session = sessions.front().session;
+				if (static_cast<time_t>(SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session)) > now)
+					break;
+				RemoveEntry(sessions.begin());
+			}
+
+			if (!keys.empty() && keys.front().created + static_cast<time_t>(lifetime) > now)
+				return;
+
+			TicketKey key;
+			if (RAND_bytes(key.name, sizeof(key.name)) <= 0 || RAND_bytes(key.aeskey, sizeof(key.aeskey)) <= 0 || RAND_bytes(key.hmackey, sizeof(key.hmackey)) <= 0)
+			{
+				ServerInstance->Logs.Log(MODNAME, LOG_DEFAULT, "Unable to generate a new session ticket key: %s", ERR_error_string(ERR_get_error(), NULL));
+				return;
+			}
+			key.created = now;
+			keys.push_front(key);
+
+			// Tickets encrypted with the previous key can still be used but are renewed with the new one.
+			while (keys.size() > 2)
+			{
+				OPENSSL_cleanse(&keys.back(), sizeof(TicketKey));
+				keys.pop_back();
+			}
+		}
+
+		/** Retrieves statistics about session resumption. */
+		Stats GetStats() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return { sessions.size(), maxsize, fullhandshakes, resumedhandshakes, hits, misses, evictions };
+		}
+
+		/** Serializes the ticket keys and cached sessions so they can be restored after a reload. */
+		std::string Serialize() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			std::string data;
+			for (const auto& key : keys)
+			{
+				std::string raw;
+				raw.append(reinterpret_cast<const char*>(key.name), sizeof(key.name));
+				raw.append(reinterpret_cast<const char*>(key.aeskey), sizeof(key.aeskey));
+				raw.append(reinterpret_cast<const char*>(key.hmackey), sizeof(key.hmackey));
+				data.append("key ").append(BinToBase64(raw)).append(" ").append(ConvToStr(key.created)).push_back('\n');
+				OPENSSL_cleanse(&raw[0], raw.size());
+			}
+
+			for (const auto& entry : sessions)
+			{
+				int len = i2d_SSL_SESSION(entry.session, NULL);
+				if (len <= 0)
+					continue;
+
+				std::string raw(len, '\0');
+				unsigned char* ptr = reinterpret_cast<unsigned char*>(&raw[0]);
+				i2d_SSL_SESSION(entry.session, &ptr);
+				data.append("session ").append(BinToBase64(raw)).push_back('\n');
+			}
+			return data;
+		}
+
+		/** Restores the ticket keys and cached sessions from data created by Serialize(). */
+		void Unserialize(const std::string& data)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			std::deque<TicketKey> newkeys;
+			irc::sepstream lines(data, '\n');
+			for (std::string line; lines.GetToken(line); )
+			{
+				irc::spacesepstream tokens(line);
+				std::string type;
+				std::string value;
+				if (!tokens.GetToken(type) || !tokens.GetToken(value))
+					continue;
+
+				const std::string raw = Base64ToBin(value);
+				if (type == "key")
+				{
+					TicketKey key;
+					std::string created;
+					if (raw.size() != sizeof(key.name) + sizeof(key.aeskey) + sizeof(key.hmackey) || !tokens.GetToken(created))
+						continue;
+
+					memcpy(key.name, raw.data(), sizeof(key.name));
+					memcpy(key.aeskey, raw.data() + sizeof(key.name), sizeof(key.aeskey));
+					memcpy(key.hmackey, raw.data() + sizeof(key.name) + sizeof(key.aeskey), sizeof(key.hmackey));
+					key.created = ConvToNum<time_t>(created);
+					newkeys.push_back(key);
+				}
+				else if (type == "session")
+				{
+					const unsigned char* ptr = reinterpret_cast<const unsigned char*>(raw.data());
+					SSL_SESSION* session = d2i_SSL_SESSION(NULL, &ptr, raw.size());
+					if (session && !Insert(session))
+						SSL_SESSION_free(session);
+				}
+			}
+
+			if (!newkeys.empty())
+				keys.swap(newkeys);
+		}
+	};
+
+	/** The session resumption state of this module. */
+	static std::unique_ptr<SessionStore> sessionstore;
+
 	class Context
 	{
 		SSL_CTX* const ctx;
@@ -248,6 +595,33 @@ namespace OpenSSL
 			SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER | SSL_VERIFY_CLIENT_ONCE, OnVerify);
 		}
 
+		void SetSessionCache(const std::string& profilename, unsigned long lifetime, bool tickets)
+		{
+			// Sessions can only be resumed by the profile which created them.
+			SSL_CTX_set_session_id_context(ctx, reinterpret_cast<const unsigned char*>(profilename.data()), std::min<size_t>(profilename.length(), SSL_MAX_SID_CTX_LENGTH));
+
+			// The sessions are stored by the module so they survive the context being replaced on rehash.
+			SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+			SSL_CTX_sess_set_new_cb(ctx, OnNewSession);
+			SSL_CTX_sess_set_get_cb(ctx, OnGetSession);
+			SSL_CTX_sess_set_remove_cb(ctx, OnRemoveSession);
+			SSL_CTX_set_timeout(ctx, lifetime);
+
+			if (tickets)
+			{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+				SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, OnTicketKey);
+#else
+				SSL_CTX_set_tlsext_ticket_key_cb(ctx, OnTicketKey);
+#endif
+				SSL_CTX_clear_options(ctx, SSL_OP_NO_TICKET);
+			}
+			else
+			{
+				SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+			}
+		}
+
 		SSL* CreateServerSession()
 		{
 			SSL* sess = SSL_new(ctx);
@@ -294,6 +668,10 @@ namespace OpenSSL
 		 */
 		const unsigned int outrecsize;
 
+		/** True if records should be handled by the kernel when possible
+		 */
+		const bool ktls;
+
 		static int error_callback(const char* str, size_t len, void* u)
 		{
 			Profile* profile = reinterpret_cast<Profile*>(u);
@@ -329,6 +707,12 @@ namespace OpenSSL
 				setoptions |= SSL_OP_NO_TLSv1_2;
 #endif
 
+#ifdef SSL_OP_ENABLE_KTLS
+			// Let the kernel handle records if it supports the negotiated cipher.
+			if (ktls)
+				setoptions |= SSL_OP_ENABLE_KTLS;
+#endif
+
 			if (!setoptions && !clearoptions)
 				return; // Nothing to do
 
@@ -345,6 +729,11 @@ namespace OpenSSL
 			, clictx(SSL_CTX_new(SSLv23_client_method()))
 			, allowrenego(tag->getBool("renegotiation")) // Disallow by default
 			, outrecsize(tag->getUInt("outrecsize", 2048, 512, 16384))
+#ifdef SSL_OP_ENABLE_KTLS
+			, ktls(tag->getBool("ktls"))
+#else
+			, ktls(false)
+#endif
 		{
 			if ((!ctx.SetDH(dh)) || (!clictx.SetDH(dh)))
 				throw Exception("Couldn't set DH parameters");
@@ -407,6 +796,8 @@ namespace OpenSSL
 			clictx.SetVerifyCert();
 			if (tag->getBool("requestclientcert", true))
 				ctx.SetVerifyCert();
+
+			ctx.SetSessionCache(name, sessionstore->GetLifetime(), sessionstore->IssueTickets());
 		}
 
 		const std::string& GetName() const { return name; }
@@ -415,6 +806,208 @@ namespace OpenSSL
 		const EVP_MD* GetDigest() { return digest; }
 		bool AllowRenegotiation() const { return allowrenego; }
 		unsigned int GetOutgoingRecordSize() const { return outrecsize; }
+		bool UseKernelTLS() const { return ktls; }
+	};
+
+	/** The state of a TLS session which can be shared between the main thread and a handshake thread. */
+	class Session final
+	{
+	 public:
+		/** The underlying OpenSSL session. */
+		SSL* const sess;
+
+		/** The socket that the session reads from and writes to directly or nullptr if the
+		 * handshake is being performed on a handshake thread using the buffers below.
+		 */
+		StreamSocket* sock = nullptr;
+
+		/** The hook which owns this session or nullptr if it has been closed. Only accessed
+		 * from the main thread.
+		 */
+		OpenSSLIOHook* hook = nullptr;
+
+		/** Data which has been received from the peer but not yet read by OpenSSL. */
+		std::string inbuf;
+
+		/** Data which has been written by OpenSSL but not yet sent to the peer. */
+		std::string outbuf;
+
+		/** Whether the peer certificate is self-signed. */
+		bool selfsigned = false;
+
+		/** The return value of the last handshake step. */
+		int result = 0;
+
+		/** The error code of the last handshake step. */
+		int error = SSL_ERROR_NONE;
+
+		Session(SSL* session)
+			: sess(session)
+		{
+		}
+
+		~Session()
+		{
+			SSL_free(sess);
+		}
+
+		/** Performs as much of the handshake as possible with the data which is available. */
+		void Handshake()
+		{
+			ERR_clear_error();
+			result = SSL_do_handshake(sess);
+			error = result > 0 ? SSL_ERROR_NONE : SSL_get_error(sess, result);
+		}
+
+		/** Sends the contents of the outgoing buffer to the specified socket.
+		 * @param to The socket to send the buffered data to.
+		 * @return 1 if all data was sent, 0 if sending would block, or -1 on error.
+		 */
+		int Flush(StreamSocket* to)
+		{
+			while (!outbuf.empty())
+			{
+				int ret = SocketEngine::Send(to, outbuf.data(), outbuf.size(), 0);
+				if (ret > 0)
+				{
+					outbuf.erase(0, ret);
+					continue;
+				}
+
+				if (ret < 0 && SocketEngine::IgnoreError())
+				{
+					SocketEngine::ChangeEventMask(to, FD_WRITE_WILL_BLOCK);
+					return 0;
+				}
+				return -1;
+			}
+			return 1;
+		}
+
+		/** Receives data from the specified socket into the incoming buffer.
+		 * @param from The socket to receive data from.
+		 * @return The number of bytes received or -1 if the socket was closed or errored.
+		 */
+		int Fill(StreamSocket* from)
+		{
+			char* buffer = ServerInstance->GetReadBuffer();
+			const size_t bufsiz = ServerInstance->Config->NetBufferSize;
+
+			// Limit how much is read at once so a flooding peer can not stall the main thread.
+			size_t total = 0;
+			while (total < bufsiz * 4)
+			{
+				int ret = SocketEngine::Recv(from, buffer, bufsiz, 0);
+				if (ret > 0)
+				{
+					inbuf.append(buffer, ret);
+					total += ret;
+					if (static_cast<size_t>(ret) < bufsiz)
+						break;
+					continue;
+				}
+
+				if (ret < 0 && SocketEngine::IgnoreError())
+					break;
+
+				from->SetError(ret ? SocketEngine::LastError() : "Connection closed");
+				return -1;
+			}
+			return static_cast<int>(total);
+		}
+	};
+
+	/** A thread which performs handshake steps for sessions and hands them back to the main thread. */
+	class HandshakeThread final
+		: public SocketThread
+	{
+	 private:
+		/** Sessions which are waiting for a handshake step to be performed. */
+		std::deque<std::shared_ptr<Session>> queue;
+
+		/** Sessions which have had a handshake step performed. */
+		std::vector<std::shared_ptr<Session>> done;
+
+		/** Whether this thread has been asked to stop. Guarded by the queue lock. */
+		bool stop = false;
+
+	 protected:
+		void OnStart() override
+		{
+			LockQueue();
+			while (!stop)
+			{
+				if (queue.empty())
+				{
+					WaitForQueue();
+					continue;
+				}
+
+				std::shared_ptr<Session> session = std::move(queue.front());
+				queue.pop_front();
+				UnlockQueue();
+
+				// The main thread does not touch the session until it has been handed back.
+				session->Handshake();
+
+				LockQueue();
+				done.push_back(std::move(session));
+				NotifyParent();
+			}
+			UnlockQueue();
+		}
+
+		void OnStop() override
+		{
+			LockQueue();
+			stop = true;
+			UnlockQueueWakeup();
+		}
+
+	 public:
+		/** Queues a handshake step for the specified session. */
+		void Submit(std::shared_ptr<Session> session)
+		{
+			LockQueue();
+			queue.push_back(std::move(session));
+			UnlockQueueWakeup();
+		}
+
+		void OnNotify() override;
+	};
+
+	/** A pool of threads which perform the CPU-intensive part of TLS handshakes. */
+	class HandshakePool final
+	{
+	 private:
+		/** The threads in this pool. */
+		std::vector<std::unique_ptr<HandshakeThread>> threads;
+
+		/** The thread which the next session will be submitted to. */
+		size_t next = 0;
+
+	 public:
+		HandshakePool(size_t count)
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				threads.push_back(std::make_unique<HandshakeThread>());
+				threads.back()->Start();
+			}
+		}
+
+		~HandshakePool()
+		{
+			for (const auto& thread : threads)
+				thread->Stop();
+		}
+
+		/** Queues a handshake step for the specified session on the next thread in the pool. */
+		void Submit(std::shared_ptr<Session> session)
+		{
+			threads[next]->Submit(std::move(session));
+			next = (next + 1) % threads.size();
+		}
 	};
 
 	namespace BIOMethod
@@ -458,6 +1051,9 @@ namespace OpenSSL
 
 static BIO_METHOD* biomethods;
 
+/** The threads which handshakes are performed on or nullptr to perform them on the main thread. */
+static std::unique_ptr<OpenSSL::HandshakePool> handshakepool;
+
 static int OnVerify(int preverify_ok, X509_STORE_CTX *ctx)
 {
 	/* XXX: This will allow self signed certificates.
@@ -467,21 +1063,163 @@ static int OnVerify(int preverify_ok, X509_STORE_CTX *ctx)
 	 */
 	int ve = X509_STORE_CTX_get_error(ctx);
 
-	SelfSigned = (ve == X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT);
+	SSL* ssl = static_cast<SSL*>(X509_STORE_CTX_get_ex_data(ctx, SSL_get_ex_data_X509_STORE_CTX_idx()));
+	OpenSSL::Session* session = static_cast<OpenSSL::Session*>(SSL_get_ex_data(ssl, exdataindex));
+	session->selfsigned = (ve == X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT);
 
 	return 1;
 }
 
+static int OnNewSession(SSL* ssl, SSL_SESSION* session)
+{
+	return OpenSSL::sessionstore->Add(session);
+}
+
+static SSL_SESSION* OnGetSession(SSL* ssl, const unsigned char* id, int len, int* copy)
+{
+	// The store has already given us a reference to the session for OpenSSL.
+	*copy = 0;
+	return OpenSSL::sessionstore->Get(id, len);
+}
+
+static void OnRemoveSession(SSL_CTX* ctx, SSL_SESSION* session)
+{
+	OpenSSL::sessionstore->Remove(session);
+}
+
+static int OnTicketKey(SSL* ssl, unsigned char* name, unsigned char* iv, EVP_CIPHER_CTX* cctx, TicketMACContext* hctx, int enc)
+{
+	OpenSSL::TicketKey key;
+	int ret = 1;
+	if (enc)
+	{
+		if (!OpenSSL::sessionstore->GetCurrentKey(key))
+			return 0; // Don't issue a ticket.
+
+		if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) <= 0)
+			return -1;
+
+		memcpy(name, key.name, sizeof(key.name));
+		if (!EVP_EncryptInit_ex(cctx, EVP_aes_256_cbc(), NULL, key.aeskey, iv))
+			return -1;
+	}
+	else
+	{
+		ret = OpenSSL::sessionstore->FindKey(name, key);
+		if (!ret)
+			return 0; // Unknown or expired key, perform a full handshake.
+
+		if (!EVP_DecryptInit_ex(cctx, EVP_aes_256_cbc(), NULL, key.aeskey, iv))
+			return -1;
+	}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+	char digest[] = "SHA256";
+	OSSL_PARAM params[] = {
+		OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+		OSSL_PARAM_construct_end()
+	};
+	if (!EVP_MAC_init(hctx, key.hmackey, sizeof(key.hmackey), params))
+		return -1;
+#else
+	if (!HMAC_Init_ex(hctx, key.hmackey, sizeof(key.hmackey), EVP_sha256(), NULL))
+		return -1;
+#endif
+
+	OPENSSL_cleanse(&key, sizeof(key));
+	return ret;
+}
+
 class OpenSSLIOHook : public SSLIOHook
 {
  private:
 	SSL* sess;
+	std::shared_ptr<OpenSSL::Session> session;
+	StreamSocket* const stream;
 	issl_status status;
 	bool data_to_write = false;
 
+	// Whether the session has been submitted to a handshake thread and not handed back yet
+	bool inflight = false;
+
+	// Whether a handshake step has been handed back and its result has not been looked at yet
+	bool stepdone = false;
+
+	// Whether the handshake can not progress until more data is received from the peer
+	bool needinput;
+
+	// Performs the handshake on a handshake thread, returns the same as Handshake()
+	int OffloadedHandshake(StreamSocket* user)
+	{
+		this->status = ISSL_HANDSHAKING;
+		if (inflight)
+			return 0;
+
+		// Send whatever the last handshake step produced before doing anything else
+		int flushret = session->Flush(user);
+		if (flushret < 0)
+		{
+			CloseSession();
+			return -1;
+		}
+		else if (flushret == 0)
+		{
+			SocketEngine::ChangeEventMask(user, FD_WANT_NO_READ | FD_WANT_SINGLE_WRITE);
+			return 0;
+		}
+
+		if (stepdone)
+		{
+			stepdone = false;
+			if (session->result > 0)
+			{
+				// Handshake complete, from now on the session uses the socket directly
+				session->sock = user;
+				VerifyCertificate();
+				CountHandshake();
+
+				status = ISSL_OPEN;
+
+				int mask = FD_WANT_POLL_READ | FD_WANT_NO_WRITE | FD_ADD_TRIAL_WRITE;
+				if (!session->inbuf.empty())
+					mask |= FD_ADD_TRIAL_READ;
+				SocketEngine::ChangeEventMask(user, mask);
+				return 1;
+			}
+			else if (session->error != SSL_ERROR_WANT_READ && session->error != SSL_ERROR_WANT_WRITE)
+			{
+				CloseSession();
+				return -1;
+			}
+			needinput = true;
+		}
+
+		int fillret = session->Fill(user);
+		if (fillret < 0)
+		{
+			CloseSession();
+			return -1;
+		}
+		else if (needinput && !fillret)
+		{
+			SocketEngine::ChangeEventMask(user, FD_WANT_POLL_READ | FD_WANT_NO_WRITE);
+			return 0;
+		}
+
+		// Hand the session over to a handshake thread, OnHandshakeStep() is called when it is done
+		needinput = false;
+		inflight = true;
+		SocketEngine::ChangeEventMask(user, FD_WANT_NO_READ | FD_WANT_NO_WRITE);
+		handshakepool->Submit(session);
+		return 0;
+	}
+
 	// Returns 1 if handshake succeeded, 0 if it is still in progress, -1 if it failed
 	int Handshake(StreamSocket* user)
 	{
+		if (!session->sock)
+			return OffloadedHandshake(user);
+
 		ERR_clear_error();
 		int ret = SSL_do_handshake(sess);
 		if (ret < 0)
@@ -510,6 +1248,8 @@ class OpenSSLIOHook : public SSLIOHook
 		{
 			// Handshake complete.
 			VerifyCertificate();
+			CountHandshake();
+			CheckKernelTLS();
 
 			status = ISSL_OPEN;
 
@@ -526,14 +1266,36 @@ class OpenSSLIOHook : public SSLIOHook
 
 	void CloseSession()
 	{
-		if (sess)
+		if (session)
 		{
-			SSL_shutdown(sess);
-			SSL_free(sess);
+			// If a handshake thread is using the session it is freed when the thread is done with it
+			if (!inflight)
+				SSL_shutdown(sess);
+			session->hook = nullptr;
+			session.reset();
 		}
 		sess = NULL;
 		certificate = NULL;
 		status = ISSL_NONE;
+		inflight = false;
+	}
+
+	void CountHandshake()
+	{
+		if (SSL_is_server(sess))
+			OpenSSL::sessionstore->CountHandshake(SSL_session_reused(sess));
+	}
+
+	// Steps out of the send path if OpenSSL handed it over to the kernel. Reads always go
+	// through OpenSSL as the kernel hands alerts, key updates and session tickets back to
+	// userspace as control messages which a plain recv() would fail on.
+	void CheckKernelTLS()
+	{
+		kernelsend = BIO_get_ktls_send(SSL_get_wbio(sess));
+		const bool kernelread = BIO_get_ktls_recv(SSL_get_rbio(sess));
+
+		if (kernelsend || kernelread)
+			ServerInstance->Logs.Log(MODNAME, LOG_DEBUG, "Session %p is using kernel TLS (send: %s, receive: %s)", (void*)sess, kernelsend ? "yes" : "no", kernelread ? "yes" : "no");
 	}
 
 	void VerifyCertificate()
@@ -554,7 +1316,11 @@ class OpenSSLIOHook : public SSLIOHook
 
 		certinfo->invalid = (SSL_get_verify_result(sess) != X509_V_OK);
 
-		if (!SelfSigned)
+		// The certificate is not verified again when a session is resumed
+		if (SSL_session_reused(sess))
+			session->selfsigned = (SSL_get_verify_result(sess) == X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT);
+
+		if (!session->selfsigned)
 		{
 			certinfo->unknownsigner = false;
 			certinfo->trusted = true;
@@ -604,9 +1370,7 @@ class OpenSSLIOHook : public SSLIOHook
 			// The other side is trying to renegotiate, kill the connection and change status
 			// to ISSL_NONE so CheckRenego() closes the session
 			status = ISSL_NONE;
-			BIO* bio = SSL_get_rbio(sess);
-			EventHandler* eh = static_cast<StreamSocket*>(BIO_get_data(bio));
-			SocketEngine::Shutdown(eh, 2);
+			SocketEngine::Shutdown(stream, 2);
 		}
 	}
 
@@ -640,21 +1404,55 @@ class OpenSSLIOHook : public SSLIOHook
 	friend void StaticSSLInfoCallback(const SSL* ssl, int where, int rc);
 
  public:
-	OpenSSLIOHook(IOHookProvider* hookprov, StreamSocket* sock, SSL* session)
+	OpenSSLIOHook(IOHookProvider* hookprov, StreamSocket* sock, SSL* ssl)
 		: SSLIOHook(hookprov)
-		, sess(session)
+		, sess(ssl)
+		, session(std::make_shared<OpenSSL::Session>(ssl))
+		, stream(sock)
 		, status(ISSL_NONE)
+		, needinput(SSL_is_server(ssl))
 	{
-		// Create BIO instance and store a pointer to the socket in it which will be used by the read and write functions
-		BIO* bio = BIO_new(biomethods);
-		BIO_set_data(bio, sock);
+		// If there are no handshake threads the session uses the socket directly from the start
+		const bool ktls = GetProfile().UseKernelTLS();
+		session->hook = this;
+		if (!handshakepool || ktls)
+			session->sock = sock;
+
+		BIO* bio;
+		if (ktls)
+		{
+			// OpenSSL can only hand the session keys to the kernel through its own socket BIO
+			bio = BIO_new_socket(sock->GetFd(), BIO_NOCLOSE);
+		}
+		else
+		{
+			// Create BIO instance and store a pointer to the session in it which will be used by the read and write functions
+			bio = BIO_new(biomethods);
+			BIO_set_data(bio, session.get());
+		}
 		SSL_set_bio(sess, bio, bio);
 
-		SSL_set_ex_data(sess, exdataindex, this);
+		SSL_set_ex_data(sess, exdataindex, session.get());
 		sock->AddIOHook(this);
 		Handshake(sock);
 	}
 
+	~OpenSSLIOHook() override
+	{
+		if (session)
+			session->hook = nullptr;
+	}
+
+	// Called on the main thread when a handshake thread has finished with the session
+	void OnHandshakeStep()
+	{
+		inflight = false;
+		stepdone = true;
+
+		// Go through PrepareIO() again to look at the result of the step
+		SocketEngine::ChangeEventMask(stream, FD_ADD_TRIAL_READ);
+	}
+
 	void OnStreamSocketClose(StreamSocket* user) override
 	{
 		CloseSession();
@@ -793,6 +1591,9 @@ class OpenSSLIOHook : public SSLIOHook
 
 	bool GetServerName(std::string& out) const override
 	{
+		if (!sess || inflight)
+			return false;
+
 		const char* name = SSL_get_servername(sess, TLSEXT_NAMETYPE_host_name);
 		if (!name)
 			return false;
@@ -805,17 +1606,42 @@ class OpenSSLIOHook : public SSLIOHook
 	OpenSSL::Profile& GetProfile();
 };
 
+void OpenSSL::HandshakeThread::OnNotify()
+{
+	LockQueue();
+	std::vector<std::shared_ptr<Session>> finished;
+	finished.swap(done);
+	UnlockQueue();
+
+	for (const auto& session : finished)
+	{
+		// The hook is gone if the socket was closed while the step was in progress
+		if (session->hook)
+			session->hook->OnHandshakeStep();
+	}
+}
+
 static void StaticSSLInfoCallback(const SSL* ssl, int where, int rc)
 {
-	OpenSSLIOHook* hook = static_cast<OpenSSLIOHook*>(SSL_get_ex_data(ssl, exdataindex));
-	hook->SSLInfoCallback(where, rc);
+	// Sessions which do not have a socket may be in use by a handshake thread
+	OpenSSL::Session* session = static_cast<OpenSSL::Session*>(SSL_get_ex_data(ssl, exdataindex));
+	if (session->sock && session->hook)
+		session->hook->SSLInfoCallback(where, rc);
 }
 
 static int OpenSSL::BIOMethod::write(BIO* bio, const char* buffer, int size)
 {
 	BIO_clear_retry_flags(bio);
 
-	StreamSocket* sock = static_cast<StreamSocket*>(BIO_get_data(bio));
+	OpenSSL::Session* session = static_cast<OpenSSL::Session*>(BIO_get_data(bio));
+	StreamSocket* sock = session->sock;
+	if (!sock)
+	{
+		// Handshake is being performed on a handshake thread, the main thread sends this later
+		session->outbuf.append(buffer, size);
+		return size;
+	}
+
 	if (sock->GetEventMask() & FD_WRITE_WILL_BLOCK)
 	{
 		// Writes blocked earlier, don't retry syscall
@@ -823,6 +1649,19 @@ static int OpenSSL::BIOMethod::write(BIO* bio, const char* buffer, int size)
 		return -1;
 	}
 
+	// Anything left over from the handshake has to be sent first
+	if (!session->outbuf.empty())
+	{
+		int flushret = session->Flush(sock);
+		if (flushret < 0)
+			return -1;
+		else if (flushret == 0)
+		{
+			BIO_set_retry_write(bio);
+			return -1;
+		}
+	}
+
 	int ret = SocketEngine::Send(sock, buffer, size, 0);
 	if ((ret < size) && ((ret > 0) || (SocketEngine::IgnoreError())))
 	{
@@ -838,7 +1677,23 @@ static int OpenSSL::BIOMethod::read(BIO* bio, char* buffer, int size)
 {
 	BIO_clear_retry_flags(bio);
 
-	StreamSocket* sock = static_cast<StreamSocket*>(BIO_get_data(bio));
+	// Data received while the handshake was being performed on a handshake thread is read first
+	OpenSSL::Session* session = static_cast<OpenSSL::Session*>(BIO_get_data(bio));
+	if (!session->inbuf.empty())
+	{
+		const size_t count = std::min<size_t>(size, session->inbuf.size());
+		memcpy(buffer, session->inbuf.data(), count);
+		session->inbuf.erase(0, count);
+		return static_cast<int>(count);
+	}
+
+	StreamSocket* sock = session->sock;
+	if (!sock)
+	{
+		BIO_set_retry_read(bio);
+		return -1;
+	}
+
 	if (sock->GetEventMask() & FD_READ_WILL_BLOCK)
 	{
 		// Reads blocked earlier, don't retry syscall
@@ -893,12 +1748,19 @@ OpenSSL::Profile& OpenSSLIOHook::GetProfile()
 	return static_cast<OpenSSLIOHookProvider*>(hookprov)->GetProfile();
 }
 
-class ModuleSSLOpenSSL : public Module
+class ModuleSSLOpenSSL
+	: public Module
+	, public ReloadModule::EventListener
+	, public Stats::EventListener
+	, public Timer
 {
 	typedef std::vector<reference<OpenSSLIOHookProvider> > ProfileList;
 
 	ProfileList profiles;
 
+	// Whether the configuration has been read since this module was loaded
+	bool configured = false;
+
 	void ReadProfiles()
 	{
 		ProfileList newprofiles;
@@ -943,14 +1805,20 @@ class ModuleSSLOpenSSL : public Module
  public:
 	ModuleSSLOpenSSL()
 		: Module(VF_VENDOR, "Allows TLS encrypted connections using the OpenSSL library.")
+		, ReloadModule::EventListener(this)
+		, Stats::EventListener(this)
+		, Timer(60, true)
 	{
 		// Initialize OpenSSL
 		OPENSSL_init_ssl(0, NULL);
 		biomethods = OpenSSL::BIOMethod::alloc();
+		OpenSSL::sessionstore = std::make_unique<OpenSSL::SessionStore>();
 	}
 
 	~ModuleSSLOpenSSL() override
 	{
+		handshakepool.reset();
+		OpenSSL::sessionstore.reset();
 		BIO_meth_free(biomethods);
 	}
 
@@ -963,11 +1831,26 @@ class ModuleSSLOpenSSL : public Module
 		exdataindex = SSL_get_ex_new_index(0, exdatastr, NULL, NULL, NULL);
 		if (exdataindex < 0)
 			throw ModuleException("Failed to register application specific data");
+
+		ServerInstance->Timers.AddTimer(this);
 	}
 
 	void ReadConfig(ConfigStatus& status) override
 	{
 		auto tag = ServerInstance->Config->ConfValue("openssl");
+		if (!configured)
+		{
+			// Changing the number of handshake threads requires the module to be reloaded.
+			const unsigned long threads = tag->getUInt("threads", 0, 0, 64);
+			if (threads)
+				handshakepool = std::make_unique<OpenSSL::HandshakePool>(threads);
+			configured = true;
+		}
+
+		// The session cache settings only apply to profiles created after this.
+		OpenSSL::sessionstore->Configure(tag->getUInt("sessioncachesize", 20480), tag->getDuration("sessionlifetime", 3600, 60), tag->getBool("sessiontickets", true));
+		OpenSSL::sessionstore->Expire(ServerInstance->Time());
+
 		if (status.initial || tag->getBool("onrehash", true))
 			ReadProfiles();
 	}
@@ -1010,6 +1893,40 @@ class ModuleSSLOpenSSL : public Module
 			return MOD_RES_DENY;
 		return MOD_RES_PASSTHRU;
 	}
+
+	bool Tick(time_t currtime) override
+	{
+		OpenSSL::sessionstore->Expire(currtime);
+		return true;
+	}
+
+	ModResult OnStats(Stats::Context& stats) override
+	{
+		if (stats.GetSymbol() != 'z')
+			return MOD_RES_PASSTHRU;
+
+		const OpenSSL::SessionStore::Stats sessionstats = OpenSSL::sessionstore->GetStats();
+		const unsigned long handshakes = sessionstats.fullhandshakes + sessionstats.resumedhandshakes;
+		stats.AddRow(249, InspIRCd::Format("OpenSSL sessions: %zu/%zu cached; Handshakes: %lu; Resumed: %lu (%lu%%); Cache hits: %lu; Cache misses: %lu; Evictions: %lu",
+			sessionstats.size, sessionstats.maxsize, handshakes, sessionstats.resumedhandshakes, handshakes ? sessionstats.resumedhandshakes * 100 / handshakes : 0,
+			sessionstats.hits, sessionstats.misses, sessionstats.evictions));
+		return MOD_RES_PASSTHRU;
+	}
+
+	void OnReloadModuleSave(Module* mod, ReloadModule::CustomData& cd) override
+	{
+		// Keep the ticket keys and cached sessions so clients can still resume after a reload.
+		if (mod == this)
+			cd.add(this, new std::string(OpenSSL::sessionstore->Serialize()));
+	}
+
+	void OnReloadModuleRestore(Module* mod, void* data) override
+	{
+		std::string* serialized = static_cast<std::string*>(data);
+		OpenSSL::sessionstore->Unserialize(*serialized);
+		OPENSSL_cleanse(&(*serialized)[0], serialized->size());
+		delete serialized;
+	}
 };
 
 MODULE_INIT(ModuleSSLOpenSSL)
@@ -0,0 +1,248 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/// $CompilerFlags: find_compiler_flags("zlib")
+/// $LinkerFlags: find_linker_flags("zlib" "-lz")
+
+/// $PackageInfo: require_system("arch") pkgconf zlib
+/// $PackageInfo: require_system("centos") pkgconfig zlib-devel
+/// $PackageInfo: require_system("darwin") pkg-config zlib
+/// $PackageInfo: require_system("debian") pkg-config zlib1g-dev
+/// $PackageInfo: require_system("ubuntu") pkg-config zlib1g-dev
+
+
+#include "inspircd.h"
+#include "modules/ziplink.h"
+
+#include <zlib.h>
+
+class ZlibHook final
+	: public ZipLink::Hook
+{
+ private:
+	/** The stream which compresses data written to the socket. */
+	z_stream deflater;
+
+	/** The stream which decompresses data read from the socket. */
+	z_stream inflater;
+
+	/** The buffer which the streams write their output to. */
+	Bytef buffer[16384];
+
+	/** Compresses some data.
+	 * @param data The data to compress.
+	 * @param length The length of the data to compress.
+	 * @param flush The zlib flush mode to compress with.
+	 * @param out The buffer to append the compressed data to.
+	 * @return True if the data was compressed; otherwise, false.
+	 */
+	bool Deflate(const char* data, size_t length, int flush, std::string& out)
+	{
+		deflater.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+		deflater.avail_in = static_cast<uInt>(length);
+		do
+		{
+			deflater.next_out = buffer;
+			deflater.avail_out = sizeof(buffer);
+			if (deflate(&deflater, flush) == Z_STREAM_ERROR)
+				return false;
+
+			out.append(reinterpret_cast<const char*>(buffer), sizeof(buffer) - deflater.avail_out);
+		}
+		while (!deflater.avail_out);
+		return true;
+	}
+
+	/** Decompresses some data.
+	 * @param data The data to decompress.
+	 * @param out The buffer to append the decompressed data to.
+	 * @return True if the data was decompressed; otherwise, false.
+	 */
+	bool Inflate(const std::string& data, std::string& out)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const size_t prevlength = out.length();
+
+		inflater.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+		inflater.avail_in = static_cast<uInt>(data.length());
+		do
+		{
+			inflater.next_out = buffer;
+			inflater.avail_out = sizeof(buffer);
+
+			// The remote server never ends the stream so Z_STREAM_END is an error too.
+			const int ret = inflate(&inflater, Z_SYNC_FLUSH);
+			if (ret != Z_OK && ret != Z_BUF_ERROR)
+				return false;
+
+			out.append(reinterpret_cast<const char*>(buffer), sizeof(buffer) - inflater.avail_out);
+			if (ret == Z_BUF_ERROR)
+				break;
+		}
+		while (inflater.avail_in || !inflater.avail_out);
+
+		zipin += data.length();
+		rawin += out.length() - prevlength;
+		unziptime += std::chrono::steady_clock::now() - start;
+		return true;
+	}
+
+ public:
+	ZlibHook(IOHookProvider* provider, int level)
+		: ZipLink::Hook(provider)
+	{
+		memset(&deflater, 0, sizeof(deflater));
+		memset(&inflater, 0, sizeof(inflater));
+
+		int ret = deflateInit(&deflater, level);
+		if (ret == Z_OK)
+		{
+			ret = inflateInit(&inflater);
+			if (ret != Z_OK)
+				deflateEnd(&deflater);
+		}
+
+		if (ret != Z_OK)
+			throw ModuleException(std::string("Unable to initialise zlib: ") + zError(ret), provider->creator);
+	}
+
+	~ZlibHook() override
+	{
+		deflateEnd(&deflater);
+		inflateEnd(&inflater);
+	}
+
+	bool StartDecompression(std::string& recvq) override
+	{
+		decompressing = true;
+		if (recvq.empty())
+			return true;
+
+		std::string compressed;
+		compressed.swap(recvq);
+		return Inflate(compressed, recvq);
+	}
+
+	int OnStreamSocketWrite(StreamSocket* sock, StreamSocket::SendQueue& uppersendq) override
+	{
+		if (!compressing)
+		{
+			GetSendQ().moveall(uppersendq);
+			return 1;
+		}
+
+		if (uppersendq.empty())
+			return 1;
+
+		const auto start = std::chrono::steady_clock::now();
+		const size_t rawlength = uppersendq.bytes();
+
+		// Everything which is queued is flushed at once so the remote server can process it
+		// without waiting for more data to arrive.
+		std::string out;
+		bool success = true;
+		for (const auto& elem : uppersendq)
+		{
+			success = Deflate(elem.data(), elem.length(), Z_NO_FLUSH, out);
+			if (!success)
+				break;
+		}
+		if (success)
+			success = Deflate(nullptr, 0, Z_SYNC_FLUSH, out);
+		uppersendq.clear();
+
+		if (!success)
+		{
+			sock->SetError("Compression error");
+			return -1;
+		}
+
+		rawout += rawlength;
+		zipout += out.length();
+		ziptime += std::chrono::steady_clock::now() - start;
+		GetSendQ().push_back(std::move(out));
+		return 1;
+	}
+
+	void OnStreamSocketClose(StreamSocket* sock) override
+	{
+	}
+
+	int OnStreamSocketRead(StreamSocket* sock, std::string& recvq) override
+	{
+		std::string& rq = GetRecvQ();
+		if (rq.empty())
+			return 0;
+
+		if (!decompressing)
+		{
+			recvq.append(rq);
+			rq.clear();
+			return 1;
+		}
+
+		const size_t prevlength = recvq.length();
+		const bool success = Inflate(rq, recvq);
+		rq.clear();
+		if (!success)
+		{
+			sock->SetError("Decompression error");
+			return -1;
+		}
+		return recvq.length() > prevlength ? 1 : 0;
+	}
+};
+
+class ZlibProvider final
+	: public ZipLink::Provider
+{
+ public:
+	/** The level to compress data at. */
+	int level = Z_DEFAULT_COMPRESSION;
+
+	ZlibProvider(Module* mod)
+		: ZipLink::Provider(mod, "deflate")
+	{
+	}
+
+	ZipLink::Hook* Create(StreamSocket* sock) override
+	{
+		auto hook = new ZlibHook(this, level);
+		sock->PushIOHook(hook);
+		return hook;
+	}
+};
+
+class ModuleZipLinkZlib : public Module
+{
+ private:
+	reference<ZlibProvider> provider;
+
+ public:
+	ModuleZipLinkZlib()
+		: Module(VF_VENDOR, "Allows server links to be compressed using the deflate algorithm.")
+		, provider(new ZlibProvider(this))
+	{
+	}
+
+	void ReadConfig(ConfigStatus& status) override
+	{
+		auto tag = ServerInstance->Config->ConfValue("zlib");
+		provider->level = static_cast<int>(tag->getInt("level", 6, 1, 9));
+	}
+};
+
+MODULE_INIT(ModuleZipLinkZlib)
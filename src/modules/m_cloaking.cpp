@@ -385,6 +385,20 @@ class ModuleCloaking : public Module
 		return MOD_RES_PASSTHRU;
 	}
 
+	void OnGetBanHosts(User* user, std::vector<std::string>& hosts) override
+	{
+		LocalUser* lu = IS_LOCAL(user);
+		if (!lu)
+			return;
+
+		// Force the creation of cloaks if not already set.
+		OnUserConnect(lu);
+
+		CloakList* cloaklist = cu.ext.Get(user);
+		if (cloaklist)
+			hosts.insert(hosts.end(), cloaklist->begin(), cloaklist->end());
+	}
+
 	void Prioritize() override
 	{
 		/* Needs to be after m_banexception etc. */
@@ -106,6 +106,7 @@ class ModuleCodepage
 		if (!memcmp(prevmap, national_case_insensitive_map, UCHAR_MAX))
 			return;
 
+		CompiledMask::ClearCache();
 		RehashHashmap(ServerInstance->Users.clientlist);
 		RehashHashmap(ServerInstance->Users.uuidlist);
 		RehashHashmap(ServerInstance->chanlist);
@@ -58,11 +58,17 @@ static http_parser_settings parser_settings;
 
 /** A socket used for HTTP transport
  */
-class HttpServerSocket : public BufferedSocket, public Timer, public insp::intrusive_list_node<HttpServerSocket>
+class HttpServerSocket : public BufferedSocket, public Timer, public IncrementalAction, public insp::intrusive_list_node<HttpServerSocket>
 {
  private:
 	friend class ModuleHttpServer;
 
+	/** The amount of a streamed document which is generated before it is sent as a chunk. */
+	static const size_t STREAM_CHUNK_SIZE = 16 * 1024;
+
+	/** The size of the sendq at which generating a streamed document is paused until it drains. */
+	static const size_t STREAM_SENDQ = 256 * 1024;
+
 	http_parser parser;
 	http_parser_url url;
 	std::string ip;
@@ -77,6 +83,18 @@ class HttpServerSocket : public BufferedSocket, public Timer, public insp::intru
 	bool waitingcull = false;
 	bool messagecomplete = false;
 
+	/** The stream which is generating the response document, if any. */
+	std::unique_ptr<HTTPDocumentStream> stream;
+
+	/** The module which created the stream. */
+	Module* streammod = nullptr;
+
+	/** Whether the streamed document is being sent using chunked transfer encoding. */
+	bool chunked = false;
+
+	/** Whether generating the streamed document is paused until the sendq drains. */
+	bool streamwaiting = false;
+
 	bool Tick(time_t currtime) override
 	{
 		if (!messagecomplete)
@@ -227,11 +245,13 @@ class HttpServerSocket : public BufferedSocket, public Timer, public insp::intru
 
 	~HttpServerSocket() override
 	{
+		StopStream();
 		sockets.erase(this);
 	}
 
 	void Close() override
 	{
+		StopStream();
 		if (waitingcull || !HasFd())
 			return;
 
@@ -265,10 +285,6 @@ class HttpServerSocket : public BufferedSocket, public Timer, public insp::intru
 
 	void SendHeaders(unsigned long size, unsigned int response, HTTPHeaders &rheaders)
 	{
-		WriteData(InspIRCd::Format("HTTP/%u.%u %u %s\r\n", parser.http_major ? parser.http_major : 1, parser.http_major ? parser.http_minor : 1, response, http_status_str((http_status)response)));
-
-		rheaders.CreateHeader("Date", InspIRCd::TimeString(ServerInstance->Time(), "%a, %d %b %Y %H:%M:%S GMT", true));
-		rheaders.CreateHeader("Server", INSPIRCD_BRANCH);
 		rheaders.SetHeader("Content-Length", ConvToStr(size));
 
 		if (size)
@@ -276,6 +292,16 @@ class HttpServerSocket : public BufferedSocket, public Timer, public insp::intru
 		else
 			rheaders.RemoveHeader("Content-Type");
 
+		WriteHeaders(response, rheaders);
+	}
+
+	void WriteHeaders(unsigned int response, HTTPHeaders& rheaders)
+	{
+		WriteData(InspIRCd::Format("HTTP/%u.%u %u %s\r\n", parser.http_major ? parser.http_major : 1, parser.http_major ? parser.http_minor : 1, response, http_status_str((http_status)response)));
+
+		rheaders.CreateHeader("Date", InspIRCd::TimeString(ServerInstance->Time(), "%a, %d %b %Y %H:%M:%S GMT", true));
+		rheaders.CreateHeader("Server", INSPIRCD_BRANCH);
+
 		/* Supporting Connection: keep-alive causes a whole world of hurt synchronizing timeouts,
 		 * so remove it, its not essential for what we need.
 		 */
@@ -326,6 +352,85 @@ class HttpServerSocket : public BufferedSocket, public Timer, public insp::intru
 		Page(n->str(), response, hheaders);
 	}
 
+	void Stream(HTTPDocumentStream* str, Module* mod, unsigned int response, HTTPHeaders* hheaders)
+	{
+		stream.reset(str);
+		streammod = mod;
+
+		// HTTP/1.0 clients do not understand chunked transfer encoding so the end of the
+		// document is marked by closing the connection instead.
+		chunked = parser.http_major > 1 || (parser.http_major == 1 && parser.http_minor >= 1);
+		if (chunked)
+			hheaders->SetHeader("Transfer-Encoding", "chunked");
+		hheaders->RemoveHeader("Content-Length");
+		hheaders->CreateHeader("Content-Type", "text/html");
+		WriteHeaders(response, *hheaders);
+
+		// The rest of the document is sent over the next few iterations of the main loop.
+		if (Step())
+			ServerInstance->IncrementalActions.AddAction(this);
+	}
+
+	/** @copydoc IncrementalAction::Step */
+	bool Step() override
+	{
+		if (!stream || waitingcull)
+			return false;
+
+		std::stringstream chunk;
+		bool more = true;
+		while (more && static_cast<size_t>(chunk.tellp()) < STREAM_CHUNK_SIZE)
+			more = stream->Generate(chunk);
+
+		const std::string data = chunk.str();
+		if (!data.empty())
+		{
+			if (chunked)
+				WriteData(InspIRCd::Format("%zx\r\n", data.length()));
+			WriteData(data);
+			if (chunked)
+				WriteData("\r\n");
+		}
+
+		if (!more)
+		{
+			if (chunked)
+				WriteData("0\r\n\r\n");
+			stream.reset();
+			BufferedSocket::Close(true);
+			return false;
+		}
+
+		if (GetSendQSize() >= STREAM_SENDQ)
+		{
+			// Resumed by OnEventHandlerWrite when the sendq drains.
+			streamwaiting = true;
+			return false;
+		}
+		return true;
+	}
+
+	void StopStream()
+	{
+		if (!stream)
+			return;
+
+		ServerInstance->IncrementalActions.DelAction(this);
+		stream.reset();
+	}
+
+	void OnEventHandlerWrite() override
+	{
+		BufferedSocket::OnEventHandlerWrite();
+
+		// Resume generating the document once the sendq has drained to half of its limit.
+		if (stream && streamwaiting && GetSendQSize() <= STREAM_SENDQ / 2)
+		{
+			streamwaiting = false;
+			ServerInstance->IncrementalActions.AddAction(this);
+		}
+	}
+
 	bool ParseURI(const std::string& uristr, HTTPRequestURI& out)
 	{
 		http_parser_url_init(&url);
@@ -396,7 +501,10 @@ class HTTPdAPIImpl : public HTTPdAPIBase
 
 	void SendResponse(HTTPDocumentResponse& resp) override
 	{
-		resp.src.sock->Page(resp.document, resp.responsecode, &resp.headers);
+		if (resp.stream)
+			resp.src.sock->Stream(resp.stream, resp.module, resp.responsecode, &resp.headers);
+		else
+			resp.src.sock->Page(resp.document, resp.responsecode, &resp.headers);
 	}
 };
 
@@ -451,6 +559,11 @@ class ModuleHttpServer : public Module
 				sock->Cull();
 				delete sock;
 			}
+			else if (sock->stream && sock->streammod == mod)
+			{
+				// The stream can not outlive the module which created it.
+				sock->Close();
+			}
 		}
 	}
 
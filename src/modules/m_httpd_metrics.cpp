@@ -0,0 +1,290 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "inspircd.h"
+#include "modules/dns.h"
+#include "modules/httpd.h"
+#include "xline.h"
+
+namespace Metrics
+{
+	/** Writes metrics in the OpenMetrics text format. Every value which is written is either a
+	 * counter which is maintained as it changes or the size of a container so that a scrape does
+	 * not need to walk the users or channels on the network.
+	 */
+	class Writer final
+	{
+	 private:
+		std::ostream& data;
+
+	 public:
+		Writer(std::ostream& out)
+			: data(out)
+		{
+			// Durations are written in seconds so they need more precision than the default.
+			data.precision(9);
+		}
+
+		/** Escapes a string for use as the value of a label. */
+		static std::string Escape(const std::string& str)
+		{
+			std::string ret;
+			ret.reserve(str.length());
+			for (const auto chr : str)
+			{
+				if (chr == '\\' || chr == '"')
+					ret.push_back('\\');
+				else if (chr == '\n')
+				{
+					ret.append("\\n");
+					continue;
+				}
+				ret.push_back(chr);
+			}
+			return ret;
+		}
+
+		/** Builds a label set for a sample. */
+		static std::string Label(const char* name, const std::string& value)
+		{
+			return InspIRCd::Format("{%s=\"%s\"}", name, Escape(value).c_str());
+		}
+
+		/** Starts a new metric family.
+		 * @param name The name of the metric family.
+		 * @param type The OpenMetrics type of the metric family.
+		 * @param help A description of the metric family.
+		 */
+		void Family(const char* name, const char* type, const char* help)
+		{
+			data << "# TYPE " << name << ' ' << type << "\n# HELP " << name << ' ' << help << '\n';
+		}
+
+		/** Writes a sample for the current metric family.
+		 * @param name The name of the sample including any suffix required by its type.
+		 * @param value The value of the sample.
+		 * @param labels The labels of the sample as built by Label().
+		 */
+		template <typename Value>
+		void Sample(const char* name, Value value, const std::string& labels = std::string())
+		{
+			data << name << labels << ' ' << value << '\n';
+		}
+
+		/** Writes a metric family which only has a single gauge sample. */
+		template <typename Value>
+		void Gauge(const char* name, Value value, const char* help)
+		{
+			Family(name, "gauge", help);
+			Sample(name, value);
+		}
+
+		/** Writes a metric family which only has a single counter sample. */
+		template <typename Value>
+		void Counter(const char* name, Value value, const char* help)
+		{
+			Family(name, "counter", help);
+			Sample((std::string(name) + "_total").c_str(), value);
+		}
+
+		/** Writes the marker which ends the exposition. */
+		void End()
+		{
+			data << "# EOF\n";
+		}
+	};
+
+	double ToSeconds(const LatencyHistogram::Duration& duration)
+	{
+		return std::chrono::duration<double>(duration).count();
+	}
+
+	void General(Writer& out)
+	{
+		out.Family("inspircd_build", "info", "The version of the server software.");
+		out.Sample("inspircd_build_info", 1, Writer::Label("version", INSPIRCD_VERSION));
+
+		out.Gauge("inspircd_start_time_seconds", ServerInstance->startup_time, "The time at which the server was started.");
+		out.Gauge("inspircd_users", ServerInstance->Users.GetUsers().size(), "The number of users on the network including unregistered and service users.");
+		out.Gauge("inspircd_local_users", ServerInstance->Users.LocalUserCount(), "The number of registered users on this server.");
+		out.Gauge("inspircd_unregistered_users", ServerInstance->Users.UnregisteredUserCount(), "The number of users on this server which have not finished registering.");
+		out.Gauge("inspircd_opers", ServerInstance->Users.all_opers.size(), "The number of server operators on the network.");
+		out.Gauge("inspircd_channels", ServerInstance->GetChans().size(), "The number of channels on the network.");
+
+		out.Counter("inspircd_connections_accepted", ServerInstance->stats.Accept, "The number of connections which have been accepted.");
+		out.Counter("inspircd_connections_refused", ServerInstance->stats.Refused, "The number of connections which have been refused.");
+		out.Counter("inspircd_unknown_commands", ServerInstance->stats.Unknown, "The number of unknown commands which have been received.");
+		out.Counter("inspircd_nick_collisions", ServerInstance->stats.Collisions, "The number of nickname collisions which have been handled.");
+
+		out.Gauge("inspircd_bancache_entries", ServerInstance->BanCache.GetSize(), "The number of entries in the ban cache.");
+		out.Counter("inspircd_bancache_hits", ServerInstance->BanCache.GetHits(), "The number of ban cache lookups which found an entry.");
+		out.Counter("inspircd_bancache_misses", ServerInstance->BanCache.GetMisses(), "The number of ban cache lookups which did not find an entry.");
+		out.Counter("inspircd_bancache_evictions", ServerInstance->BanCache.GetEvictions(), "The number of entries which have been evicted from the ban cache.");
+
+		out.Counter("inspircd_loop_stalls", ServerInstance->LoopStats.GetStalls(), "The number of main loop iterations which have exceeded the loop budget.");
+	}
+
+	void Sockets(Writer& out)
+	{
+		const SocketEngine::Statistics& stats = SocketEngine::GetStats();
+
+		out.Gauge("inspircd_sockets", SocketEngine::GetUsedFds(), "The number of file descriptors which are registered with the socket engine.");
+		out.Gauge("inspircd_sockets_max", SocketEngine::GetMaxFds(), "The maximum number of file descriptors which the socket engine can handle.");
+
+		out.Family("inspircd_socket_events", "counter", "The number of socket events which have been handled.");
+		out.Sample("inspircd_socket_events_total", stats.ReadEvents, Writer::Label("type", "read"));
+		out.Sample("inspircd_socket_events_total", stats.WriteEvents, Writer::Label("type", "write"));
+		out.Sample("inspircd_socket_events_total", stats.ErrorEvents, Writer::Label("type", "error"));
+
+		out.Counter("inspircd_socket_received_bytes", stats.BytesIn, "The number of bytes which have been received.");
+		out.Counter("inspircd_socket_sent_bytes", stats.BytesOut, "The number of bytes which have been sent.");
+		out.Counter("inspircd_socket_interest_changes", stats.ChangeCalls, "The number of system calls made to update the interest set of the socket engine.");
+		out.Counter("inspircd_socket_interest_changes_coalesced", stats.ChangesCoalesced, "The number of interest changes which did not need a system call.");
+
+		out.Gauge("inspircd_sendq_bytes", StreamSocket::SendQueue::allbytes(), "The number of bytes which are waiting to be sent.");
+		out.Gauge("inspircd_recvq_bytes", StreamSocket::GetTotalRecvQSize(), "The number of bytes which have been received but not yet processed as of the last read.");
+	}
+
+	void Commands(Writer& out)
+	{
+		const CommandParser::CommandMap& commands = ServerInstance->Parser.GetCommands();
+
+		out.Family("inspircd_command_uses", "counter", "The number of times each command has been used.");
+		for (const auto& [name, cmd] : commands)
+			out.Sample("inspircd_command_uses_total", cmd->use_count, Writer::Label("command", name));
+
+		out.Family("inspircd_command_received_bytes", "counter", "The number of bytes which have been received in each command.");
+		for (const auto& [name, cmd] : commands)
+			out.Sample("inspircd_command_received_bytes_total", cmd->bytes_in, Writer::Label("command", name));
+
+		out.Family("inspircd_command_sent_bytes", "counter", "The number of bytes which have been sent in response to each command.");
+		for (const auto& [name, cmd] : commands)
+			out.Sample("inspircd_command_sent_bytes_total", cmd->bytes_out, Writer::Label("command", name));
+
+		static const double quantiles[] = { 0.5, 0.9, 0.99 };
+		out.Family("inspircd_command_duration_seconds", "summary", "The time which each command has taken to execute.");
+		for (const auto& [name, cmd] : commands)
+		{
+			const LatencyHistogram& latency = cmd->latency;
+			if (!latency.GetCount())
+				continue;
+
+			const std::string label = Writer::Escape(name);
+			for (const auto quantile : quantiles)
+			{
+				const std::string labels = InspIRCd::Format("{command=\"%s\",quantile=\"%g\"}", label.c_str(), quantile);
+				out.Sample("inspircd_command_duration_seconds", ToSeconds(latency.GetPercentile(quantile * 100)), labels);
+			}
+
+			const std::string labels = Writer::Label("command", name);
+			out.Sample("inspircd_command_duration_seconds_sum", ToSeconds(latency.GetTotal()), labels);
+			out.Sample("inspircd_command_duration_seconds_count", latency.GetCount(), labels);
+		}
+	}
+
+	void XLines(Writer& out)
+	{
+		out.Family("inspircd_xlines", "gauge", "The number of X-lines of each type including any which have expired but not been removed yet.");
+		for (const auto& type : ServerInstance->XLines->GetAllTypes())
+			out.Sample("inspircd_xlines", ServerInstance->XLines->GetCount(type), Writer::Label("type", type));
+	}
+
+	void DNS(Writer& out, DNS::Manager* manager)
+	{
+		out.Family("inspircd_dns_replies", "counter", "The number of DNS replies which have been received.");
+		out.Sample("inspircd_dns_replies_total", ServerInstance->stats.DnsGood, Writer::Label("result", "success"));
+		out.Sample("inspircd_dns_replies_total", ServerInstance->stats.DnsBad, Writer::Label("result", "failure"));
+
+		if (!manager)
+			return;
+
+		out.Gauge("inspircd_dns_cache_entries", manager->GetCacheSize(), "The number of DNS results which are cached.");
+		out.Counter("inspircd_dns_cache_hits", manager->GetCacheHits(), "The number of DNS requests which have been answered from the cache.");
+		out.Counter("inspircd_dns_cache_misses", manager->GetCacheMisses(), "The number of DNS requests which could not be answered from the cache.");
+	}
+
+	void Servers(Writer& out)
+	{
+		ProtocolInterface::ServerList servers;
+		ServerInstance->PI->GetServerList(servers);
+
+		out.Gauge("inspircd_servers", servers.size(), "The number of servers on the network.");
+
+		out.Family("inspircd_link_received_bytes", "counter", "The number of bytes of protocol messages which have been received from each directly linked server.");
+		for (const auto& server : servers)
+		{
+			if (server.parentname == ServerInstance->Config->ServerName)
+				out.Sample("inspircd_link_received_bytes_total", server.bytesin, Writer::Label("server", server.servername));
+		}
+
+		out.Family("inspircd_link_sent_bytes", "counter", "The number of bytes of protocol messages which have been sent to each directly linked server.");
+		for (const auto& server : servers)
+		{
+			if (server.parentname == ServerInstance->Config->ServerName)
+				out.Sample("inspircd_link_sent_bytes_total", server.bytesout, Writer::Label("server", server.servername));
+		}
+
+		out.Family("inspircd_link_latency_seconds", "gauge", "The round trip time to each server on the network.");
+		for (const auto& server : servers)
+		{
+			if (server.servername != ServerInstance->Config->ServerName)
+				out.Sample("inspircd_link_latency_seconds", server.latencyms / 1000.0, Writer::Label("server", server.servername));
+		}
+	}
+}
+
+class ModuleHttpMetrics : public Module, public HTTPRequestEventListener
+{
+ private:
+	HTTPdAPI API;
+	dynamic_reference_nocheck<DNS::Manager> DNS;
+
+ public:
+	ModuleHttpMetrics()
+		: Module(VF_VENDOR, "Provides OpenMetrics statistics about the server over HTTP via the /metrics path.")
+		, HTTPRequestEventListener(this)
+		, API(this)
+		, DNS(this, "DNS")
+	{
+	}
+
+	ModResult OnHTTPRequest(HTTPRequest& request) override
+	{
+		if (request.GetPath() != "/metrics")
+			return MOD_RES_PASSTHRU;
+
+		ServerInstance->Logs.Log(MODNAME, LOG_DEBUG, "Handling HTTP request for %s", request.GetPath().c_str());
+
+		std::stringstream buffer;
+		Metrics::Writer out(buffer);
+		Metrics::General(out);
+		Metrics::Sockets(out);
+		Metrics::Commands(out);
+		Metrics::XLines(out);
+		Metrics::DNS(out, *DNS);
+		Metrics::Servers(out);
+		out.End();
+
+		HTTPDocumentResponse response(this, request, &buffer, 200);
+		response.headers.SetHeader("X-Powered-By", MODNAME);
+		response.headers.SetHeader("Content-Type", "application/openmetrics-text; version=1.0.0; charset=utf-8");
+		API->SendResponse(response);
+		return MOD_RES_DENY;
+	}
+};
+
+MODULE_INIT(ModuleHttpMetrics)
@@ -136,30 +136,48 @@ namespace Stats
 		data << "<socketcount>" << (SocketEngine::GetUsedFds()) << "</socketcount><socketmax>" << SocketEngine::GetMaxFds() << "</socketmax>";
 		data << "<uptime><boot_time_t>" << ServerInstance->startup_time << "</boot_time_t></uptime>";
 		data << "<currenttime>" << ServerInstance->Time() << "</currenttime>";
+		data << "<bancache><size>" << ServerInstance->BanCache.GetSize() << "</size><maxsize>" << ServerInstance->Config->BanCacheSize
+			<< "</maxsize><hits>" << ServerInstance->BanCache.GetHits() << "</hits><misses>" << ServerInstance->BanCache.GetMisses()
+			<< "</misses><evictions>" << ServerInstance->BanCache.GetEvictions() << "</evictions></bancache>";
 
 		data << ISupport;
 		return data << "</general>";
 	}
 
-	std::ostream& XLines(std::ostream& data)
+	/** Writes the next few X-lines of a type.
+	 * @param data The stream to write to.
+	 * @param xltype The type of X-line to write.
+	 * @param lastmask The mask of the last X-line which was written or an empty string to start
+	 *                 from the first one. This is updated to the mask of the last X-line written.
+	 * @return True if there are more X-lines of the type to write; otherwise, false.
+	 */
+	bool XLines(std::ostream& data, const std::string& xltype, std::string& lastmask)
 	{
-		data << "<xlines>";
-		for (const auto& xltype : ServerInstance->XLines->GetAllTypes())
+		// Expired lines are removed when the type is first looked up and skipped after that.
+		XLineLookup* lookup = ServerInstance->XLines->GetAll(xltype, lastmask.empty());
+		if (!lookup)
+			return false;
+
+		const time_t now = ServerInstance->Time();
+		size_t written = 0;
+		for (LookupIter it = lastmask.empty() ? lookup->begin() : lookup->upper_bound(lastmask); it != lookup->end(); ++it)
 		{
-			XLineLookup* lookup = ServerInstance->XLines->GetAll(xltype);
-			if (!lookup)
+			if (written >= 100)
+				return true;
+
+			XLine* xline = it->second;
+			lastmask = it->first;
+			if (xline->duration && now > xline->expiry)
 				continue;
 
-			for (const auto& [_, xline] : *lookup)
-			{
-				data << "<xline type=\"" << xltype << "\"><mask>"
-					<< Sanitize(xline->Displayable()) << "</mask><settime>"
-					<< xline->set_time << "</settime><duration>" << xline->duration
-					<< "</duration><reason>" << Sanitize(xline->reason)
-					<< "</reason></xline>";
-			}
+			data << "<xline type=\"" << xltype << "\"><mask>"
+				<< Sanitize(xline->Displayable()) << "</mask><settime>"
+				<< xline->set_time << "</settime><duration>" << xline->duration
+				<< "</duration><reason>" << Sanitize(xline->reason)
+				<< "</reason></xline>";
+			written++;
 		}
-		return data << "</xlines>";
+		return false;
 	}
 
 	std::ostream& Modules(std::ostream& data)
@@ -168,26 +186,39 @@ namespace Stats
 		for (const auto& [modname, mod] : ServerInstance->Modules.GetModules())
 		{
 			data << "<module><name>" << modname << "</name><description>"
-				<< Sanitize(mod->description) << "</description></module>";
+				<< Sanitize(mod->description) << "</description>";
+
+			if (!mod->hookstats.empty())
+			{
+				data << "<hooks>";
+				for (const auto& [hookname, hookstats] : mod->hookstats)
+				{
+					data << "<hook><name>" << Sanitize(hookname) << "</name><calls>" << hookstats.calls
+						<< "</calls><totalns>" << std::chrono::duration_cast<std::chrono::nanoseconds>(hookstats.total).count()
+						<< "</totalns><maxns>" << std::chrono::duration_cast<std::chrono::nanoseconds>(hookstats.max).count()
+						<< "</maxns></hook>";
+				}
+				data << "</hooks>";
+			}
+			data << "</module>";
 		}
 		return data << "</modulelist>";
 	}
 
-	std::ostream& Channels(std::ostream& data)
-	{
-		data << "<channellist>";
 
-		for (const auto& [_, c] : ServerInstance->GetChans())
+	void DumpChannel(std::ostream& data, Channel* c, bool showmembers)
+	{
+		data << "<channel>";
+		data << "<usercount>" << c->GetUsers().size() << "</usercount><channelname>" << Sanitize(c->name) << "</channelname>";
+		data << "<channeltopic>";
+		data << "<topictext>" << Sanitize(c->topic) << "</topictext>";
+		data << "<setby>" << Sanitize(c->setby) << "</setby>";
+		data << "<settime>" << c->topicset << "</settime>";
+		data << "</channeltopic>";
+		data << "<channelmodes>" << Sanitize(c->ChanModes(true)) << "</channelmodes>";
+
+		if (showmembers)
 		{
-			data << "<channel>";
-			data << "<usercount>" << c->GetUsers().size() << "</usercount><channelname>" << Sanitize(c->name) << "</channelname>";
-			data << "<channeltopic>";
-			data << "<topictext>" << Sanitize(c->topic) << "</topictext>";
-			data << "<setby>" << Sanitize(c->setby) << "</setby>";
-			data << "<settime>" << c->topicset << "</settime>";
-			data << "</channeltopic>";
-			data << "<channelmodes>" << Sanitize(c->ChanModes(true)) << "</channelmodes>";
-
 			for (const auto& [__, memb] : c->GetUsers())
 			{
 				data << "<channelmember><uid>" << memb->user->uuid << "</uid><privs>"
@@ -196,13 +227,11 @@ namespace Stats
 				DumpMeta(data, memb);
 				data << "</channelmember>";
 			}
-
-			DumpMeta(data, c);
-
-			data << "</channel>";
 		}
 
-		return data << "</channellist>";
+		DumpMeta(data, c);
+
+		data << "</channel>";
 	}
 
 	std::ostream& DumpUser(std::ostream& data, User* u)
@@ -236,19 +265,6 @@ namespace Stats
 		return data;
 	}
 
-	std::ostream& Users(std::ostream& data)
-	{
-		data << "<userlist>";
-		for (const auto& [_, u] : ServerInstance->Users.GetUsers())
-		{
-			if (u->registered != REG_ALL)
-				continue;
-
-			DumpUser(data, u);
-		}
-		return data << "</userlist>";
-	}
-
 	std::ostream& Servers(std::ostream& data)
 	{
 		data << "<serverlist>";
@@ -277,7 +293,21 @@ namespace Stats
 
 		for (const auto& [cmdname, cmd] : ServerInstance->Parser.GetCommands())
 		{
-			data << "<command><name>" << cmdname << "</name><usecount>" << cmd->use_count << "</usecount></command>";
+			data << "<command><name>" << cmdname << "</name><usecount>" << cmd->use_count << "</usecount><bytesin>"
+				<< cmd->bytes_in << "</bytesin><bytesout>" << cmd->bytes_out << "</bytesout>";
+
+			const LatencyHistogram& latency = cmd->latency;
+			if (latency.GetCount())
+			{
+				const auto usecs = [](const LatencyHistogram::Duration& duration) {
+					return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+				};
+				data << "<latency><p50us>" << usecs(latency.GetPercentile(50)) << "</p50us><p90us>"
+					<< usecs(latency.GetPercentile(90)) << "</p90us><p99us>" << usecs(latency.GetPercentile(99))
+					<< "</p99us><maxus>" << usecs(latency.GetMax()) << "</maxus><totalus>" << usecs(latency.GetTotal())
+					<< "</totalus></latency>";
+			}
+			data << "</command>";
 		}
 		return data << "</commandlist>";
 	}
@@ -317,70 +347,275 @@ namespace Stats
 		}
 	};
 
-	std::ostream& ListUsers(std::ostream& data, const HTTPQueryParameters& params)
+	/** The sections of the statistics document in the order they are sent. */
+	enum Section
+	{
+		SECTION_SERVERINFO,
+		SECTION_GENERAL,
+		SECTION_XLINES,
+		SECTION_MODULES,
+		SECTION_CHANNELS,
+		SECTION_USERS,
+		SECTION_SERVERS,
+		SECTION_COMMANDS
+	};
+
+	/** Generates the statistics document a piece at a time. The users and channels which are
+	 * listed are chosen when their section is reached and are then written one at a time, and
+	 * X-lines are written a few at a time, so that the whole document never has to be held in
+	 * memory. Users and channels which are destroyed before they are reached are skipped.
+	 */
+	class Document final
+		: public HTTPDocumentStream
 	{
-		if (params.empty())
-			return Users(data);
+	 private:
+		/** The sections to write. */
+		std::vector<Section> sections;
 
-		data << "<userlist>";
+		/** The query parameters which the document was requested with. */
+		const HTTPQueryParameters params;
 
-		// Filters
-		size_t limit = params.getNum<size_t>("limit");
-		bool showunreg = params.getBool("showunreg");
-		bool localonly = params.getBool("localonly");
+		/** The index of the section which is currently being written. */
+		size_t section = 0;
 
-		// Minimum time since a user's last message
-		unsigned long min_idle = params.getDuration("minidle");
-		time_t maxlastmsg = ServerInstance->Time() - min_idle;
+		/** Whether the document has been started. */
+		bool started = false;
 
-		if (min_idle)
-			// We can only check idle times on local users
-			localonly = true;
+		/** Whether the list for the current section has been built. */
+		bool listing = false;
 
-		// Sorting
-		const std::string& sortmethod = params.getString("sortby");
-		bool desc = params.getBool("desc", false);
+		/** The names of the channels, UUIDs of the users, or types of X-line to write in the current section. */
+		std::vector<std::string> keys;
 
-		OrderBy orderby;
-		if (stdalgo::string::equalsci(sortmethod, "nick"))
-			orderby = OB_NICK;
-		else if (stdalgo::string::equalsci(sortmethod, "lastmsg"))
+		/** The position within the keys of the current section. */
+		size_t position = 0;
+
+		/** The mask of the last X-line which was written. */
+		std::string lastmask;
+
+		/** Removes the keys which are outside of the page that was requested.
+		 * @param list The list to paginate.
+		 */
+		template <typename T>
+		void Paginate(std::vector<T>& list) const
 		{
-			orderby = OB_LASTMSG;
-			// We can only check idle times on local users
-			localonly = true;
+			const size_t offset = params.getNum<size_t>("offset");
+			const size_t limit = params.getNum<size_t>("limit");
+
+			list.erase(list.begin(), list.begin() + std::min(offset, list.size()));
+			if (limit && list.size() > limit)
+				list.resize(limit);
 		}
-		else
-			orderby = OB_NONE;
 
-		typedef std::list<User*> NewUserList;
-		NewUserList user_list;
-		for (const auto& [_, u] : ServerInstance->Users.GetUsers())
+		void ListChannels()
 		{
-			if (!showunreg && u->registered != REG_ALL)
-				continue;
+			const size_t minusers = params.getNum<size_t>("minusers");
 
-			LocalUser* lu = IS_LOCAL(u);
-			if (localonly && !lu)
-				continue;
+			std::vector<Channel*> chans;
+			for (const auto& [_, chan] : ServerInstance->GetChans())
+			{
+				if (chan->GetUsers().size() >= minusers)
+					chans.push_back(chan);
+			}
 
-			if (min_idle && lu->idle_lastmsg > maxlastmsg)
-				continue;
+			// Channels are sorted by name so that pages do not overlap.
+			std::sort(chans.begin(), chans.end(), [](Channel* chan1, Channel* chan2) {
+				return irc::insensitive_swo()(chan1->name, chan2->name);
+			});
+			Paginate(chans);
 
-			user_list.push_back(u);
+			keys.reserve(chans.size());
+			for (auto* chan : chans)
+				keys.push_back(chan->name);
 		}
 
-		UserSorter sorter(orderby, desc);
-		if (sorter.order != OB_NONE && !(!localonly && sorter.order == OB_LASTMSG))
-			user_list.sort(sorter);
+		void ListUsers()
+		{
+			bool showunreg = params.getBool("showunreg");
+			bool localonly = params.getBool("localonly");
+			bool opersonly = params.getBool("opersonly");
 
-		size_t count = 0;
-		for (NewUserList::const_iterator i = user_list.begin(); i != user_list.end() && (!limit || count < limit); ++i, ++count)
-			DumpUser(data, *i);
+			// Minimum time since a user's last message
+			unsigned long min_idle = params.getDuration("minidle");
+			time_t maxlastmsg = ServerInstance->Time() - min_idle;
 
-		data << "</userlist>";
-		return data;
-	}
+			if (min_idle)
+				// We can only check idle times on local users
+				localonly = true;
+
+			// Sorting
+			const std::string& sortmethod = params.getString("sortby");
+			bool desc = params.getBool("desc", false);
+
+			OrderBy orderby;
+			if (stdalgo::string::equalsci(sortmethod, "lastmsg"))
+			{
+				orderby = OB_LASTMSG;
+				// We can only check idle times on local users
+				localonly = true;
+			}
+			else
+			{
+				// Users are sorted by nick by default so that pages do not overlap.
+				orderby = OB_NICK;
+			}
+
+			std::vector<User*> users;
+			for (const auto& [_, u] : ServerInstance->Users.GetUsers())
+			{
+				if (!showunreg && u->registered != REG_ALL)
+					continue;
+
+				if (opersonly && !u->IsOper())
+					continue;
+
+				LocalUser* lu = IS_LOCAL(u);
+				if (localonly && !lu)
+					continue;
+
+				if (min_idle && lu->idle_lastmsg > maxlastmsg)
+					continue;
+
+				users.push_back(u);
+			}
+
+			std::sort(users.begin(), users.end(), UserSorter(orderby, desc));
+			Paginate(users);
+
+			keys.reserve(users.size());
+			for (auto* user : users)
+				keys.push_back(user->uuid);
+		}
+
+		/** Writes the next piece of a list section.
+		 * @param data The stream to write to.
+		 * @return True if the section has more to write; otherwise, false.
+		 */
+		bool GenerateList(std::ostream& data)
+		{
+			const Section current = sections[section];
+			if (!listing)
+			{
+				listing = true;
+				switch (current)
+				{
+					case SECTION_XLINES:
+						keys = ServerInstance->XLines->GetAllTypes();
+						data << "<xlines>";
+						break;
+					case SECTION_CHANNELS:
+						ListChannels();
+						data << "<channellist>";
+						break;
+					default:
+						ListUsers();
+						data << "<userlist>";
+						break;
+				}
+				return true;
+			}
+
+			if (current == SECTION_XLINES && position < keys.size())
+			{
+				if (!XLines(data, keys[position], lastmask))
+				{
+					lastmask.clear();
+					position++;
+				}
+				return true;
+			}
+
+			while (position < keys.size())
+			{
+				const std::string& key = keys[position++];
+				if (current == SECTION_CHANNELS)
+				{
+					Channel* chan = ServerInstance->FindChan(key);
+					if (chan)
+					{
+						DumpChannel(data, chan, params.getBool("showmembers", true));
+						return true;
+					}
+				}
+				else
+				{
+					User* user = ServerInstance->Users.FindUUID(key);
+					if (user && !user->quitting)
+					{
+						DumpUser(data, user);
+						return true;
+					}
+				}
+			}
+
+			switch (current)
+			{
+				case SECTION_XLINES:
+					data << "</xlines>";
+					break;
+				case SECTION_CHANNELS:
+					data << "</channellist>";
+					break;
+				default:
+					data << "</userlist>";
+					break;
+			}
+
+			listing = false;
+			keys.clear();
+			position = 0;
+			return false;
+		}
+
+	 public:
+		Document(const std::vector<Section>& Sections, const HTTPQueryParameters& Params)
+			: sections(Sections)
+			, params(Params)
+		{
+		}
+
+		bool Generate(std::ostream& data) override
+		{
+			if (!started)
+			{
+				started = true;
+				data << "<inspircdstats>";
+				return true;
+			}
+
+			if (section >= sections.size())
+			{
+				data << "</inspircdstats>";
+				return false;
+			}
+
+			switch (sections[section])
+			{
+				case SECTION_SERVERINFO:
+					data << ServerInfo;
+					break;
+				case SECTION_GENERAL:
+					data << General;
+					break;
+				case SECTION_MODULES:
+					data << Modules;
+					break;
+				case SECTION_SERVERS:
+					data << Servers;
+					break;
+				case SECTION_COMMANDS:
+					data << Commands;
+					break;
+				default:
+					if (GenerateList(data))
+						return true;
+					break;
+			}
+
+			section++;
+			return true;
+		}
+	};
 }
 
 class ModuleHttpStats : public Module, public HTTPRequestEventListener
@@ -404,58 +639,56 @@ class ModuleHttpStats : public Module, public HTTPRequestEventListener
 	{
 		auto conf = ServerInstance->Config->ConfValue("httpstats");
 
-		// Parameterized queries may cause a performance issue
-		// Due to the sheer volume of data
-		// So default them to disabled
 		enableparams = conf->getBool("enableparams");
 	}
 
 	ModResult HandleRequest(HTTPRequest* http)
 	{
-		if (http->GetPath() != "/stats")
+		const std::string& path = http->GetPath();
+		if (path != "/stats" && path.compare(0, 7, "/stats/") != 0)
 			return MOD_RES_PASSTHRU;
 
-		ServerInstance->Logs.Log(MODNAME, LOG_DEBUG, "Handling HTTP request for %s", http->GetPath().c_str());
-
-		bool found = true;
-		std::stringstream data;
-		data << "<inspircdstats>";
-
-		if (http->GetPath() == "/stats")
-		{
-			data << Stats::ServerInfo << Stats::General
-				<< Stats::XLines << Stats::Modules
-				<< Stats::Channels << Stats::Users
-				<< Stats::Servers << Stats::Commands;
-		}
-		else if (http->GetPath() == "/stats/general")
-		{
-			data << Stats::General;
-		}
-		else if (http->GetPath() == "/stats/users")
-		{
-			if (enableparams)
-				Stats::ListUsers(data, http->GetParsedURI().query_params);
-			else
-				data << Stats::Users;
-		}
-		else
-		{
-			found = false;
-		}
+		ServerInstance->Logs.Log(MODNAME, LOG_DEBUG, "Handling HTTP request for %s", path.c_str());
 
-		if (found)
+		std::vector<Stats::Section> sections;
+		if (path == "/stats")
 		{
-			data << "</inspircdstats>";
+			sections = {
+				Stats::SECTION_SERVERINFO, Stats::SECTION_GENERAL,
+				Stats::SECTION_XLINES, Stats::SECTION_MODULES,
+				Stats::SECTION_CHANNELS, Stats::SECTION_USERS,
+				Stats::SECTION_SERVERS, Stats::SECTION_COMMANDS
+			};
 		}
-		else
+		else if (path == "/stats/server")
+			sections.push_back(Stats::SECTION_SERVERINFO);
+		else if (path == "/stats/general")
+			sections.push_back(Stats::SECTION_GENERAL);
+		else if (path == "/stats/xlines")
+			sections.push_back(Stats::SECTION_XLINES);
+		else if (path == "/stats/modules")
+			sections.push_back(Stats::SECTION_MODULES);
+		else if (path == "/stats/channels")
+			sections.push_back(Stats::SECTION_CHANNELS);
+		else if (path == "/stats/users")
+			sections.push_back(Stats::SECTION_USERS);
+		else if (path == "/stats/servers")
+			sections.push_back(Stats::SECTION_SERVERS);
+		else if (path == "/stats/commands")
+			sections.push_back(Stats::SECTION_COMMANDS);
+
+		if (sections.empty())
 		{
-			data.clear();
-			data.str(std::string());
+			std::stringstream data;
+			HTTPDocumentResponse response(this, *http, &data, 404);
+			response.headers.SetHeader("X-Powered-By", MODNAME);
+			API->SendResponse(response);
+			return MOD_RES_DENY; // Handled
 		}
 
-		/* Send the document back to m_httpd */
-		HTTPDocumentResponse response(this, *http, &data, found ? 200 : 404);
+		/* Send the document back to m_httpd as it is generated */
+		const HTTPQueryParameters& params = enableparams ? http->GetParsedURI().query_params : HTTPQueryParameters();
+		HTTPDocumentResponse response(this, *http, new Stats::Document(sections, params), 200);
 		response.headers.SetHeader("X-Powered-By", MODNAME);
 		response.headers.SetHeader("Content-Type", "text/xml");
 		API->SendResponse(response);
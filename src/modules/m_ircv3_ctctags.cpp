@@ -85,16 +85,15 @@ class CommandTagMsg : public Command
 		CTCTags::TagMessage message(source, chan, msgdetails.tags_out, msgtarget.status);
 		message.SetSideEffect(true);
 
-		for (const auto& [user, memb] : chan->GetUsers())
+		for (const auto& member : chan->GetLocalMembers())
 		{
-			LocalUser* luser = IS_LOCAL(user);
+			// Members are grouped by rank so nobody after this is privileged enough.
+			if (member.rank < minrank)
+				break;
 
-			// Don't send to remote users or the user who is the source.
-			if (!luser || luser == source)
-				continue;
-
-			// Don't send to unprivileged or exempt users.
-			if (memb->getRank() < minrank || msgdetails.exemptions.count(luser))
+			// Don't send to the user who is the source or exempt users.
+			LocalUser* luser = static_cast<LocalUser*>(member.user);
+			if (luser == source || msgdetails.exemptions.count(luser))
 				continue;
 
 			// Send to users if they have the capability.
@@ -248,6 +248,7 @@ class ModuleNationalChars : public Module
 
 		memcpy(prev_map, national_case_insensitive_map, sizeof(prev_map));
 
+		CompiledMask::ClearCache();
 		RehashHashmap(ServerInstance->Users.clientlist);
 		RehashHashmap(ServerInstance->Users.uuidlist);
 		RehashHashmap(ServerInstance->chanlist);
@@ -32,6 +32,7 @@
 #include "link.h"
 #include "main.h"
 #include "modules/extban.h"
+#include "modules/ziplink.h"
 
 namespace
 {
@@ -268,6 +269,19 @@ void TreeSocket::SendCapabilities(int phase)
 	// here to not break linking to previous versions.
 	capabilities["GLOBOPS"] = ConvToStr(!!ServerInstance->Modules.Find("globops"));
 
+	// Advertise the compression methods which we can decompress so the remote server can
+	// compress the data it sends to us once the link has been authenticated.
+	std::string compression;
+	const auto ziplinks = ServerInstance->Modules.DataProviders.equal_range("ziplink");
+	for (auto it = ziplinks.first; it != ziplinks.second; ++it)
+	{
+		if (!compression.empty())
+			compression.push_back(',');
+		compression.append(it->second->name, ZipLink::PREFIX.length(), std::string::npos);
+	}
+	if (!compression.empty())
+		capabilities["COMPRESSION"] = compression;
+
 	std::stringstream capabilitystr;
 	char separator = ':';
 	for (const auto& [capkey, capvalue] : capabilities)
@@ -280,6 +294,75 @@ void TreeSocket::SendCapabilities(int phase)
 	this->WriteLine("CAPAB END");
 }
 
+void TreeSocket::StartCompression()
+{
+	auto methods = capab->CapKeys.find("COMPRESSION");
+	if (methods == capab->CapKeys.end())
+		return; // The remote server can not decompress data.
+
+	// If the remote server is already compressing then we have to use the same method.
+	ZipLink::Hook* hook = ZipLink::Hook::Find(this);
+
+	irc::commasepstream methodstream(methods->second);
+	for (std::string method; methodstream.GetToken(method); )
+	{
+		if (hook)
+		{
+			if (hook->GetMethod() != method)
+				continue;
+		}
+		else
+		{
+			auto prov = static_cast<ZipLink::Provider*>(ServerInstance->Modules.FindService(SERVICE_IOHOOK, ZipLink::PREFIX + method));
+			if (!prov)
+				continue;
+
+			hook = prov->Create(this);
+		}
+
+		// Flush the marker through the hook so the remote server receives it uncompressed.
+		WriteLine("COMPRESS " + method);
+		DoWrite();
+		hook->StartCompression();
+		return;
+	}
+}
+
+void TreeSocket::StartDecompression(const CommandBase::Params& params)
+{
+	if (params.empty())
+	{
+		SendError("Protocol violation: COMPRESS without a compression method");
+		return;
+	}
+
+	const std::string& method = params[0];
+	ZipLink::Hook* hook = ZipLink::Hook::Find(this);
+	if (hook)
+	{
+		if (hook->IsDecompressing() || hook->GetMethod() != method)
+		{
+			SendError("Protocol violation: unexpected COMPRESS " + method);
+			return;
+		}
+	}
+	else
+	{
+		auto prov = static_cast<ZipLink::Provider*>(ServerInstance->Modules.FindService(SERVICE_IOHOOK, ZipLink::PREFIX + method));
+		if (!prov)
+		{
+			SendError("Unsupported compression method: " + method);
+			return;
+		}
+
+		hook = prov->Create(this);
+	}
+
+	// Everything after the marker which has already been read is compressed.
+	if (!hook->StartDecompression(recvq))
+		SendError("Unable to decompress the data sent by the remote server");
+}
+
 /* Isolate and return the elements that are different between two comma separated lists */
 void TreeSocket::ListDifference(const std::string &one, const std::string &two, char sep,
 		std::string& mleft, std::string& mright)
@@ -71,7 +71,16 @@ CmdResult CommandResync::HandleServer(TreeServer* server, CommandBase::Params& p
 	if (!server->IsLocal())
 		throw ProtocolException("RESYNC from a server that is not directly connected");
 
+	// If the netburst which is being sent to the server has not reached the
+	// channel yet then it will be sent with the rest of the burst.
+	TreeSocket* sock = server->GetSocket();
+	if (sock->IsBurstPending(chan))
+	{
+		ServerInstance->Logs.Log(MODNAME, LOG_DEBUG, "Channel has not been sent in the netburst yet");
+		return CmdResult::SUCCESS;
+	}
+
 	// Send all known information about the channel
-	server->GetSocket()->SyncChannel(chan);
+	sock->SyncChannel(chan);
 	return CmdResult::SUCCESS;
 }
@@ -85,12 +85,118 @@ class FModeBuilder : public CmdBuilder
 	}
 };
 
-struct TreeSocket::BurstState
+/** Sends a netburst a few users and channels at a time so that bursting to a server does not block the
+ * main loop or fill the sendq of the link. Users which are created after the burst started are introduced
+ * to the server as they are created, and users and channels which are destroyed before they are reached
+ * are skipped. As joins by users which have not been sent yet are dropped by the server the list of
+ * channels is taken once every user has been sent rather than when the burst starts.
+ */
+struct TreeSocket::BurstState final
+	: public IncrementalAction
 {
+	/** The stages of a netburst in the order they are sent. */
+	enum Stage
+	{
+		STAGE_USERS,
+		STAGE_CHANNELS,
+		STAGE_DONE
+	};
+
 	SpanningTreeProtocolInterface::Server server;
-	BurstState(TreeSocket* sock) : server(sock) { }
+
+	/** The socket which the burst is being sent to. */
+	TreeSocket* const sock;
+
+	/** The stage which is currently being sent. */
+	Stage stage = STAGE_USERS;
+
+	/** The UUIDs of the users which were fully connected when the burst started. */
+	std::vector<std::string> users;
+
+	/** The names of the channels which existed when the last user was sent. */
+	std::vector<std::string> chans;
+
+	/** The position within the current stage. */
+	size_t position = 0;
+
+	/** Whether the burst is paused until the sendq of the socket drains. */
+	bool waiting = false;
+
+	/** The time at which the burst started. */
+	const time_t started;
+
+	BurstState(TreeSocket* s)
+		: server(s)
+		, sock(s)
+		, started(ServerInstance->Time())
+	{
+	}
+
+	/** @copydoc IncrementalAction::Step */
+	bool Step() override;
 };
 
+bool TreeSocket::BurstState::Step()
+{
+	if (!sock->HasFd())
+		return false;
+
+	unsigned long sent = 0;
+	while (stage != STAGE_DONE)
+	{
+		if (sock->GetSendQSize() >= Utils->BurstSendQ)
+		{
+			// Resumed by TreeSocket::OnEventHandlerWrite when the sendq drains.
+			waiting = true;
+			return false;
+		}
+
+		if (sent >= Utils->BurstChunk)
+			return true;
+
+		if (stage == STAGE_USERS)
+		{
+			if (position >= users.size())
+			{
+				// Every user is known to the server now so the membership of any channel
+				// which exists from this point on is either sent below or routed live.
+				chans.clear();
+				chans.reserve(ServerInstance->GetChans().size());
+				for (const auto& [name, _] : ServerInstance->GetChans())
+					chans.push_back(name);
+
+				stage = STAGE_CHANNELS;
+				position = 0;
+				continue;
+			}
+
+			User* user = ServerInstance->Users.FindUUID(users[position++]);
+			if (user && !user->quitting)
+			{
+				sock->SendUser(user, *this);
+				sent++;
+			}
+		}
+		else
+		{
+			if (position >= chans.size())
+			{
+				stage = STAGE_DONE;
+				sock->FinishBurst(*this);
+				break;
+			}
+
+			Channel* chan = ServerInstance->FindChan(chans[position++]);
+			if (chan)
+			{
+				sock->SyncChannel(chan, *this);
+				sent++;
+			}
+		}
+	}
+	return false;
+}
+
 /** This function is called when we want to send a netburst to a local
  * server. There is a set order we must do this, because for example
  * users require their servers to exist, and channels require their
@@ -107,19 +213,76 @@ void TreeSocket::DoBurst(TreeServer* s)
 	// Introduce all servers behind us
 	this->SendServers(Utils->TreeRoot, s);
 
-	BurstState bs(this);
-	// Introduce all users
-	this->SendUsers(bs);
+	// Users and channels are sent over the next few iterations of the main loop
+	burst = new BurstState(this);
+	burst->users.reserve(ServerInstance->Users.GetUsers().size());
+	for (const auto& [_, user] : ServerInstance->Users.GetUsers())
+	{
+		// Users which are still connecting will be introduced when they finish
+		if (user->registered == REG_ALL)
+			burst->users.push_back(user->uuid);
+	}
 
-	// Sync all channels
-	for (const auto& [_, chan] : ServerInstance->GetChans())
-		SyncChannel(chan, bs);
+	if (burst->Step())
+		ServerInstance->IncrementalActions.AddAction(burst);
+}
 
+void TreeSocket::FinishBurst(BurstState& bs)
+{
 	// Send all xlines
 	this->SendXLines();
 	Utils->Creator->GetSyncEventProvider().Call(&ServerProtocol::SyncEventListener::OnSyncNetwork, bs.server);
 	this->WriteLine(CmdBuilder("ENDBURST"));
-	ServerInstance->SNO.WriteToSnoMask('l',"Finished bursting to \002"+ s->GetName()+"\002.");
+	ServerInstance->SNO.WriteToSnoMask('l', "Finished bursting to \002%s\002 in %s.", MyRoot->GetName().c_str(),
+		InspIRCd::DurationString(std::max<time_t>(ServerInstance->Time() - bs.started, 1)).c_str());
+}
+
+void TreeSocket::StopBurst()
+{
+	if (!burst)
+		return;
+
+	ServerInstance->IncrementalActions.DelAction(burst);
+	delete burst;
+	burst = nullptr;
+}
+
+std::string TreeSocket::GetBurstProgress() const
+{
+	if (!burst || burst->stage == BurstState::STAGE_DONE)
+		return std::string();
+
+	const bool users = (burst->stage == BurstState::STAGE_USERS);
+	return InspIRCd::Format("%s: sent %zu/%zu %s, %zu bytes queued, %s for %s", MyRoot->GetName().c_str(),
+		burst->position, users ? burst->users.size() : burst->chans.size(), users ? "users" : "channels",
+		GetSendQSize(), burst->waiting ? "waiting for the sendq to drain" : "running",
+		InspIRCd::DurationString(std::max<time_t>(ServerInstance->Time() - burst->started, 1)).c_str());
+}
+
+bool TreeSocket::IsBurstPending(const Channel* chan) const
+{
+	if (!burst || burst->stage == BurstState::STAGE_DONE)
+		return false;
+
+	// The list of channels is not taken until every user has been sent.
+	if (burst->stage == BurstState::STAGE_USERS)
+		return true;
+
+	return std::any_of(burst->chans.begin() + burst->position, burst->chans.end(), [chan](const std::string& name) {
+		return irc::equals(name, chan->name);
+	});
+}
+
+void TreeSocket::OnEventHandlerWrite()
+{
+	BufferedSocket::OnEventHandlerWrite();
+
+	// Resume the netburst once the sendq has drained to half of its limit
+	if (burst && burst->waiting && GetSendQSize() <= Utils->BurstSendQ / 2)
+	{
+		burst->waiting = false;
+		ServerInstance->IncrementalActions.AddAction(burst);
+	}
 }
 
 void TreeSocket::SendServerInfo(TreeServer* from)
@@ -267,29 +430,23 @@ void TreeSocket::SyncChannel(Channel* chan)
 	SyncChannel(chan, bs);
 }
 
-/** Send all users and their state, including oper and away status and global metadata */
-void TreeSocket::SendUsers(BurstState& bs)
+/** Send a user and their state, including oper and away status and global metadata */
+void TreeSocket::SendUser(User* user, BurstState& bs)
 {
-	for (const auto& [_, user] : ServerInstance->Users.GetUsers())
-	{
-		if (user->registered != REG_ALL)
-			continue;
+	this->WriteLine(CommandUID::Builder(user));
 
-		this->WriteLine(CommandUID::Builder(user));
+	if (user->IsOper())
+		this->WriteLine(CommandOpertype::Builder(user));
 
-		if (user->IsOper())
-			this->WriteLine(CommandOpertype::Builder(user));
+	if (user->IsAway())
+		this->WriteLine(CommandAway::Builder(user));
 
-		if (user->IsAway())
-			this->WriteLine(CommandAway::Builder(user));
-
-		for (const auto& [item, obj] : user->GetExtList())
-		{
-			const std::string value = item->ToNetwork(user, obj);
-			if (!value.empty())
-				this->WriteLine(CommandMetadata::Builder(user, item->name, value));
-		}
-
-		Utils->Creator->GetSyncEventProvider().Call(&ServerProtocol::SyncEventListener::OnSyncUser, user, bs.server);
+	for (const auto& [item, obj] : user->GetExtList())
+	{
+		const std::string value = item->ToNetwork(user, obj);
+		if (!value.empty())
+			this->WriteLine(CommandMetadata::Builder(user, item->name, value));
 	}
+
+	Utils->Creator->GetSyncEventProvider().Call(&ServerProtocol::SyncEventListener::OnSyncUser, user, bs.server);
 }
@@ -21,10 +21,13 @@
 
 
 #include "inspircd.h"
+#include "modules/ziplink.h"
 
 #include "main.h"
 #include "utils.h"
 #include "link.h"
+#include "treeserver.h"
+#include "treesocket.h"
 
 ModResult ModuleSpanningTree::OnStats(Stats::Context& stats)
 {
@@ -55,5 +58,37 @@ ModResult ModuleSpanningTree::OnStats(Stats::Context& stats)
 		}
 		return MOD_RES_DENY;
 	}
+	else if (stats.GetSymbol() == 'B')
+	{
+		for (const auto* server : Utils->TreeRoot->GetChildren())
+		{
+			const std::string progress = server->GetSocket()->GetBurstProgress();
+			if (!progress.empty())
+				stats.AddRow(249, "Bursting to " + progress);
+		}
+		return MOD_RES_DENY;
+	}
+	else if (stats.GetSymbol() == 'X')
+	{
+		const auto ratio = [](unsigned long long raw, unsigned long long zip) {
+			return raw ? zip * 100.0 / raw : 100.0;
+		};
+		const auto seconds = [](const std::chrono::steady_clock::duration& duration) {
+			return std::chrono::duration<double>(duration).count();
+		};
+
+		for (const auto* server : Utils->TreeRoot->GetChildren())
+		{
+			const ZipLink::Hook* hook = ZipLink::Hook::Find(server->GetSocket());
+			if (!hook)
+				continue;
+
+			stats.AddRow(249, InspIRCd::Format("Link to %s compressed with %s: sent %llu bytes as %llu (%.1f%%) in %.3fs, received %llu bytes as %llu (%.1f%%) in %.3fs",
+				server->GetName().c_str(), hook->GetMethod().c_str(),
+				hook->rawout, hook->zipout, ratio(hook->rawout, hook->zipout), seconds(hook->ziptime),
+				hook->rawin, hook->zipin, ratio(hook->rawin, hook->zipin), seconds(hook->unziptime)));
+		}
+		return MOD_RES_DENY;
+	}
 	return MOD_RES_PASSTHRU;
 }
@@ -38,7 +38,7 @@ PingTimer::State PingTimer::TickInternal()
 	{
 		// Last ping was answered, send next ping
 		server->GetSocket()->WriteLine(CmdBuilder("PING").push(server->GetId()));
-		LastPingMsec = ServerInstance->Time() * 1000 + (ServerInstance->Time_ns() / 1000000);
+		LastPingMsec = ServerInstance->MonotonicTime();
 		// Warn next unless warnings are disabled. If they are, jump straight to timeout.
 		if (Utils->PingWarnTime)
 			return PS_WARN;
@@ -95,8 +95,7 @@ bool PingTimer::Tick(time_t currtime)
 void PingTimer::OnPong()
 {
 	// Calculate RTT
-	long ts = ServerInstance->Time() * 1000 + (ServerInstance->Time_ns() / 1000000);
-	server->rtt = ts - LastPingMsec;
+	server->rtt = ServerInstance->MonotonicTime() - LastPingMsec;
 
 	// Change state to send ping next, also reschedules the timer appropriately
 	SetState(PS_SENDPING);
@@ -26,6 +26,7 @@
 #include "inspircd.h"
 #include "utils.h"
 #include "treeserver.h"
+#include "treesocket.h"
 #include "protocolinterface.h"
 #include "commands.h"
 
@@ -45,6 +46,11 @@ void SpanningTreeProtocolInterface::GetServerList(ServerList& sl)
 		ps.opercount = server->OperCount;
 		ps.description = server->GetDesc();
 		ps.latencyms = server->rtt;
+		if (server->IsLocal())
+		{
+			ps.bytesin = server->GetSocket()->bytesin;
+			ps.bytesout = server->GetSocket()->bytesout;
+		}
 		sl.push_back(ps);
 	}
 }
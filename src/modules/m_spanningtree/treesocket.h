@@ -121,6 +121,9 @@ class TreeSocket : public BufferedSocket
 	/* Remote protocol version */
 	uint16_t proto_version = 0;
 
+	/* The netburst which is being sent to the server, if any */
+	BurstState* burst = nullptr;
+
 	/** Checks if the given servername and sid are both free
 	 */
 	bool CheckDuplicate(const std::string& servername, const std::string& sid);
@@ -133,8 +136,22 @@ class TreeSocket : public BufferedSocket
 	/** Send all known information about a channel */
 	void SyncChannel(Channel* chan, BurstState& bs);
 
-	/** Send all users and their oper state, away state and metadata */
-	void SendUsers(BurstState& bs);
+	/** Send a user and their oper state, away state and metadata */
+	void SendUser(User* user, BurstState& bs);
+
+	/** Send the rest of the netburst once all users and channels have been sent */
+	void FinishBurst(BurstState& bs);
+
+	/** Stop sending the netburst, if one is being sent */
+	void StopBurst();
+
+	/** Start compressing the data sent to the server if it can decompress it */
+	void StartCompression();
+
+	/** Start decompressing the data received from the server
+	 * @param params Parameters they sent in the COMPRESS command
+	 */
+	void StartDecompression(const CommandBase::Params& params);
 
 	/** Send all additional info about the given server to this server */
 	void SendServerInfo(TreeServer* from);
@@ -180,6 +197,12 @@ class TreeSocket : public BufferedSocket
  public:
 	const time_t age;
 
+	/** The number of bytes of protocol messages which have been received from the server. */
+	unsigned long long bytesin = 0;
+
+	/** The number of bytes of protocol messages which have been sent to the server. */
+	unsigned long long bytesout = 0;
+
 	/** Because most of the I/O gubbins are encapsulated within
 	 * BufferedSocket, we just call the superclass constructor for
 	 * most of the action, and append a few of our own values
@@ -291,11 +314,26 @@ class TreeSocket : public BufferedSocket
 	 */
 	void DoBurst(TreeServer* s);
 
+	/** Retrieves a description of the progress of the netburst which is being sent to the server.
+	 * @return The progress of the netburst or an empty string if one is not being sent.
+	 */
+	std::string GetBurstProgress() const;
+
+	/** Determines whether a channel will still be sent by the netburst which is being sent to the server.
+	 * @param chan The channel to check.
+	 * @return True if the netburst has not reached the channel yet; otherwise, false.
+	 */
+	bool IsBurstPending(const Channel* chan) const;
+
 	/** This function is called when we receive data from a remote
 	 * server.
 	 */
 	void OnDataReady() override;
 
+	/** Resumes sending the netburst when the sendq has drained
+	 */
+	void OnEventHandlerWrite() override;
+
 	/** Send one or more complete lines down the socket
 	 */
 	void WriteLine(const std::string& line);
@@ -111,6 +111,7 @@ void TreeSocket::CleanNegotiationInfo()
 Cullable::Result TreeSocket::Cull()
 {
 	Utils->timeoutlist.erase(this);
+	StopBurst();
 	if (capab && capab->ac)
 		Utils->Creator->ConnectServer(capab->ac, false);
 	return this->BufferedSocket::Cull();
@@ -193,6 +194,7 @@ bool TreeSocket::GetNextLine(std::string& line, char delim)
 		return false;
 	line.assign(recvq, 0, i);
 	recvq.erase(0, i + 1);
+	bytesin += i + 1;
 	return true;
 }
 
@@ -205,13 +207,17 @@ void TreeSocket::OnDataReady()
 	std::string line;
 	while (GetNextLine(line))
 	{
-		std::string::size_type rline = line.find('\r');
-		if (rline != std::string::npos)
-			line.erase(rline);
-		if (line.find('\0') != std::string::npos)
+		// Anything after a carriage return is discarded so only a null
+		// character which comes before the first one is an error.
+		const std::string::size_type ctrlpos = FindLineControl(line.data(), line.length());
+		if (ctrlpos != line.length())
 		{
-			SendError("Read null character from socket");
-			break;
+			if (line[ctrlpos] == '\0')
+			{
+				SendError("Read null character from socket");
+				break;
+			}
+			line.erase(ctrlpos);
 		}
 
 		try
@@ -240,4 +246,5 @@ void TreeSocket::WriteLine(const std::string& line)
 	ServerInstance->Logs.Log(MODNAME, LOG_RAWIO, "S[%d] O %s", this->GetFd(), line.c_str());
 	this->WriteData(line);
 	this->WriteData(newline);
+	bytesout += line.length() + newline.length();
 }
@@ -100,6 +100,13 @@ void TreeSocket::ProcessLine(std::string &line)
 	if (command.empty())
 		return;
 
+	// The remote server may start compressing once it has authenticated us.
+	if (command == "COMPRESS" && prefix.empty() && (LinkState == WAIT_AUTH_2 || LinkState == CONNECTED))
+	{
+		this->StartDecompression(params);
+		return;
+	}
+
 	switch (this->LinkState)
 	{
 		case WAIT_AUTH_1:
@@ -434,6 +441,7 @@ void TreeSocket::FinishAuth(const std::string& remotename, const std::string& re
 
 	// Mark the server as bursting
 	MyRoot->BeginBurst();
+	this->StartCompression();
 	this->DoBurst(MyRoot);
 
 	CommandServer::Builder(MyRoot).Forward(MyRoot);
@@ -145,22 +145,48 @@ void SpanningTreeUtilities::GetListOfServersForChannel(Channel* c, TreeSocketSet
 	}
 
 	TreeServer::ChildServers children = TreeRoot->GetChildren();
-	for (const auto& [user, memb] : c->GetUsers())
-	{
-		if (IS_LOCAL(user))
-			continue;
+	const auto addserver = [&children, &list](TreeServer* server) {
+		list.insert(server->GetSocket());
 
-		if (minrank && memb->getRank() < minrank)
-			continue;
+		TreeServer::ChildServers::iterator citer = std::find(children.begin(), children.end(), server);
+		if (citer != children.end())
+			children.erase(citer);
+	};
 
-		if (exempt_list.find(user) == exempt_list.end())
+	if (minrank)
+	{
+		// Only members with the status we're after need a copy. Members are grouped by rank
+		// so these are all at the start of the member list.
+		for (const auto& member : c->GetRemoteMembers())
+		{
+			if (member.rank < minrank)
+				break;
+
+			if (exempt_list.find(member.user) == exempt_list.end())
+				addserver(TreeServer::Get(member.user));
+		}
+	}
+	else if (exempt_list.empty())
+	{
+		// Every server which has members needs a copy.
+		for (const auto& memberserver : c->GetMemberServers())
+			addserver(static_cast<TreeServer*>(memberserver.server));
+	}
+	else
+	{
+		// A server only needs a copy if some of its members are not exempt.
+		std::map<Server*, size_t> exempted;
+		for (User* user : exempt_list)
 		{
-			TreeServer* best = TreeServer::Get(user);
-			list.insert(best->GetSocket());
+			if (!IS_LOCAL(user) && c->HasUser(user))
+				exempted[user->server]++;
+		}
 
-			TreeServer::ChildServers::iterator citer = std::find(children.begin(), children.end(), best);
-			if (citer != children.end())
-				children.erase(citer);
+		for (const auto& memberserver : c->GetMemberServers())
+		{
+			auto it = exempted.find(memberserver.server);
+			if (it == exempted.end() || it->second < memberserver.count)
+				addserver(static_cast<TreeServer*>(memberserver.server));
 		}
 	}
 
@@ -238,7 +264,10 @@ void SpanningTreeUtilities::ReadConfiguration()
 	HideSplits = security->getBool("hidesplits");
 	AnnounceTSChange = options->getBool("announcets");
 	AllowOptCommon = options->getBool("allowmismatch");
-	quiet_bursts = ServerInstance->Config->ConfValue("performance")->getBool("quietbursts");
+	auto performance = ServerInstance->Config->ConfValue("performance");
+	quiet_bursts = performance->getBool("quietbursts");
+	BurstChunk = performance->getUInt("burstchunk", 500, 1);
+	BurstSendQ = performance->getUInt("burstsendq", 1024*1024, 4096);
 	PingWarnTime = options->getDuration("pingwarning", 15);
 	PingFreq = options->getDuration("serverpingfreq", 60, 1);
 
@@ -80,6 +80,14 @@ class SpanningTreeUtilities : public Cullable
 	 */
 	bool quiet_bursts;
 
+	/** The maximum number of users or channels to send to a server per main loop iteration when bursting
+	 */
+	unsigned long BurstChunk;
+
+	/** The size the sendq of a server can grow to before bursting to it is paused until it drains
+	 */
+	unsigned long BurstSendQ;
+
 	/* Number of seconds that a server can go without ping
 	 * before opers are warned of high latency.
 	 */
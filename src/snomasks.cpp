@@ -79,6 +79,7 @@ SnomaskManager::SnomaskManager()
 	EnableSnomask('a',"ANNOUNCEMENT");		/* formerly WriteOpers() - generic notices to all opers */
 	EnableSnomask('x',"XLINE");			/* X-line notices (G/Z/Q/K/E/R/SHUN/CBan) */
 	EnableSnomask('t',"STATS");			/* Local or remote stats request */
+	EnableSnomask('p',"PERFORMANCE");		/* Slow command notices */
 }
 
 bool SnomaskManager::IsSnomaskUsable(char ch) const
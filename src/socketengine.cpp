@@ -134,6 +134,7 @@ void SocketEngine::DispatchTrialWrites()
 		EventHandler* eh = GetRef(fd);
 		if (!eh)
 			continue;
+		LoopProfiler::EventTimer timer(eh);
 		int mask = eh->event_mask;
 		eh->event_mask &= ~(FD_ADD_TRIAL_READ | FD_ADD_TRIAL_WRITE);
 		if ((mask & (FD_ADD_TRIAL_READ | FD_READ_WILL_BLOCK)) == FD_ADD_TRIAL_READ)
@@ -324,7 +325,10 @@ void SocketEngine::Statistics::UpdateReadCounters(int len_in)
 
 	ReadEvents++;
 	if (len_in > 0)
+	{
 		indata += len_in;
+		BytesIn += len_in;
+	}
 	else if (len_in < 0)
 		ErrorEvents++;
 }
@@ -335,7 +339,10 @@ void SocketEngine::Statistics::UpdateWriteCounters(int len_out)
 
 	WriteEvents++;
 	if (len_out > 0)
+	{
 		outdata += len_out;
+		BytesOut += len_out;
+	}
 	else if (len_out < 0)
 		ErrorEvents++;
 }
@@ -40,6 +40,26 @@ namespace
 	/** These are used by epoll() to hold socket events
 	 */
 	std::vector<struct epoll_event> events(16);
+
+	/** The interest state of a file descriptor.
+	 */
+	struct InterestState final
+	{
+		/** The epoll events which the kernel currently has registered for this fd. */
+		unsigned int registered = 0;
+
+		/** Whether this fd is in the dirty list. */
+		bool dirty = false;
+	};
+
+	/** This vector maps fds to their interest state.
+	 */
+	std::vector<InterestState> interests(16);
+
+	/** The fds which have had their event mask changed since the kernel interest
+	 * set was last updated. These are applied once before waiting for events.
+	 */
+	std::vector<int> dirtyfds;
 }
 
 void SocketEngine::Init()
@@ -105,12 +125,22 @@ bool SocketEngine::AddFd(EventHandler* eh, int event_mask)
 	ev.events = mask_to_epoll(event_mask);
 	ev.data.ptr = static_cast<void*>(eh);
 	int i = epoll_ctl(EngineHandle, EPOLL_CTL_ADD, fd, &ev);
+	stats.ChangeCalls++;
 	if (i < 0)
 	{
 		ServerInstance->Logs.Log("SOCKET", LOG_DEBUG, "Error adding fd: %d to socketengine: %s", fd, strerror(errno));
 		return false;
 	}
 
+	while (static_cast<unsigned int>(fd) >= interests.size())
+		interests.resize(interests.size() * 2);
+
+	// If a previous user of this fd was still in the dirty list then the
+	// stale entry will be skipped when the interest set is updated.
+	InterestState& interest = interests[fd];
+	interest.registered = ev.events;
+	interest.dirty = false;
+
 	ServerInstance->Logs.Log("SOCKET", LOG_DEBUG, "New file descriptor: %d", fd);
 
 	eh->SetEventMask(event_mask);
@@ -121,17 +151,25 @@ bool SocketEngine::AddFd(EventHandler* eh, int event_mask)
 
 void SocketEngine::OnSetEvent(EventHandler* eh, int old_mask, int new_mask)
 {
-	unsigned old_events = mask_to_epoll(old_mask);
-	unsigned new_events = mask_to_epoll(new_mask);
-	if (old_events != new_events)
+	if (mask_to_epoll(old_mask) == mask_to_epoll(new_mask))
+		return;
+
+	// We have something to tell the kernel about but we defer it until the
+	// next call to DispatchEvents so that any transitions which happen before
+	// then can be merged into one epoll_ctl call or cancelled out entirely.
+	const int fd = eh->GetFd();
+	if (fd < 0 || static_cast<unsigned int>(fd) >= interests.size())
+		return;
+
+	InterestState& interest = interests[fd];
+	if (interest.dirty)
 	{
-		// ok, we actually have something to tell the kernel about
-		struct epoll_event ev;
-		memset(&ev, 0, sizeof(ev));
-		ev.events = new_events;
-		ev.data.ptr = static_cast<void*>(eh);
-		epoll_ctl(EngineHandle, EPOLL_CTL_MOD, eh->GetFd(), &ev);
+		stats.ChangesCoalesced++;
+		return;
 	}
+
+	interest.dirty = true;
+	dirtyfds.push_back(fd);
 }
 
 void SocketEngine::DelFd(EventHandler* eh)
@@ -148,20 +186,65 @@ void SocketEngine::DelFd(EventHandler* eh)
 	// even though this argument is ignored. Since Linux 2.6.9, event can be specified as NULL when using EPOLL_CTL_DEL.
 	struct epoll_event ev;
 	int i = epoll_ctl(EngineHandle, EPOLL_CTL_DEL, fd, &ev);
+	stats.ChangeCalls++;
 
 	if (i < 0)
 	{
 		ServerInstance->Logs.Log("SOCKET", LOG_DEBUG, "epoll_ctl can't remove socket: %s", strerror(errno));
 	}
 
+	// Any pending change for this fd is now irrelevant.
+	if (static_cast<unsigned int>(fd) < interests.size())
+	{
+		InterestState& interest = interests[fd];
+		if (interest.dirty)
+			stats.ChangesCoalesced++;
+		interest.registered = 0;
+		interest.dirty = false;
+	}
+
 	SocketEngine::DelFdRef(eh);
 
 	ServerInstance->Logs.Log("SOCKET", LOG_DEBUG, "Remove file descriptor: %d", fd);
 }
 
-int SocketEngine::DispatchEvents()
+int SocketEngine::DispatchEvents(int timeout)
 {
-	int i = epoll_wait(EngineHandle, &events[0], events.size(), 1000);
+	// Tell the kernel about the final state of every fd which has changed.
+	for (const int fd : dirtyfds)
+	{
+		InterestState& interest = interests[fd];
+		if (!interest.dirty)
+			continue; // Removed from the socket engine since being marked.
+
+		interest.dirty = false;
+		EventHandler* eh = GetRef(fd);
+		if (!eh)
+			continue;
+
+		const unsigned int new_events = mask_to_epoll(eh->GetEventMask());
+		if (new_events == interest.registered)
+		{
+			// The changes since the last update cancelled each other out.
+			stats.ChangesCoalesced++;
+			continue;
+		}
+
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = new_events;
+		ev.data.ptr = static_cast<void*>(eh);
+		epoll_ctl(EngineHandle, EPOLL_CTL_MOD, fd, &ev);
+		stats.ChangeCalls++;
+		interest.registered = new_events;
+	}
+	dirtyfds.clear();
+
+	// If there are trial reads or writes waiting then the data they are for
+	// will not generate another edge so we must not block waiting for one.
+	ServerInstance->LoopStats.StartPhase(LoopProfiler::PHASE_WAIT);
+	int i = epoll_wait(EngineHandle, &events[0], events.size(), trials.empty() ? timeout : 0);
+	ServerInstance->LoopStats.StartPhase(LoopProfiler::PHASE_DISPATCH);
 	ServerInstance->UpdateTime();
 
 	stats.TotalEvents += i;
@@ -176,6 +259,7 @@ int SocketEngine::DispatchEvents()
 		if (fd < 0)
 			continue;
 
+		LoopProfiler::EventTimer timer(eh);
 		if (ev.events & EPOLLHUP)
 		{
 			stats.ErrorEvents++;
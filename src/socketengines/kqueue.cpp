@@ -144,6 +144,18 @@ void SocketEngine::DelFd(EventHandler* eh)
 
 void SocketEngine::OnSetEvent(EventHandler* eh, int old_mask, int new_mask)
 {
+	if ((new_mask & FD_WANT_NO_READ) && !(old_mask & FD_WANT_NO_READ))
+	{
+		// stop reading
+		struct kevent* ke = GetChangeKE();
+		EV_SET(ke, eh->GetFd(), EVFILT_READ, EV_DISABLE, 0, 0, udata_cast(eh));
+	}
+	else if ((old_mask & FD_WANT_NO_READ) && !(new_mask & FD_WANT_NO_READ))
+	{
+		// start reading again
+		struct kevent* ke = GetChangeKE();
+		EV_SET(ke, eh->GetFd(), EVFILT_READ, EV_ENABLE, 0, 0, udata_cast(eh));
+	}
 	if ((new_mask & FD_WANT_POLL_WRITE) && !(old_mask & FD_WANT_POLL_WRITE))
 	{
 		// new poll-style write
@@ -163,13 +175,19 @@ void SocketEngine::OnSetEvent(EventHandler* eh, int old_mask, int new_mask)
 	}
 }
 
-int SocketEngine::DispatchEvents()
+int SocketEngine::DispatchEvents(int timeout)
 {
+	// Don't block waiting for events if there are trial reads or writes waiting.
+	if (!trials.empty())
+		timeout = 0;
+
 	struct timespec ts;
-	ts.tv_nsec = 0;
-	ts.tv_sec = 1;
+	ts.tv_sec = timeout / 1000;
+	ts.tv_nsec = (timeout % 1000) * 1000000L;
 
+	ServerInstance->LoopStats.StartPhase(LoopProfiler::PHASE_WAIT);
 	int i = kevent(EngineHandle, &changelist.front(), ChangePos, &ke_list.front(), ke_list.size(), &ts);
+	ServerInstance->LoopStats.StartPhase(LoopProfiler::PHASE_DISPATCH);
 	ChangePos = 0;
 	ServerInstance->UpdateTime();
 
@@ -192,6 +210,7 @@ int SocketEngine::DispatchEvents()
 		if (fd < 0)
 			continue;
 
+		LoopProfiler::EventTimer timer(eh);
 		if (kev.flags & EV_EOF)
 		{
 			stats.ErrorEvents++;
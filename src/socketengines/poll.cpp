@@ -154,9 +154,15 @@ void SocketEngine::DelFd(EventHandler* eh)
 			"(Filled gap with: %d (index: %d))", fd, index, last_fd, last_index);
 }
 
-int SocketEngine::DispatchEvents()
+int SocketEngine::DispatchEvents(int timeout)
 {
-	int i = poll(&events[0], CurrentSetSize, 1000);
+	// Don't block waiting for events if there are trial reads or writes waiting.
+	if (!trials.empty())
+		timeout = 0;
+
+	ServerInstance->LoopStats.StartPhase(LoopProfiler::PHASE_WAIT);
+	int i = poll(&events[0], CurrentSetSize, timeout);
+	ServerInstance->LoopStats.StartPhase(LoopProfiler::PHASE_DISPATCH);
 	int processed = 0;
 	ServerInstance->UpdateTime();
 
@@ -175,6 +181,7 @@ int SocketEngine::DispatchEvents()
 		if (!eh)
 			continue;
 
+		LoopProfiler::EventTimer timer(eh);
 		if (revents & POLLHUP)
 		{
 			eh->OnEventHandlerError(0);
@@ -127,15 +127,21 @@ void SocketEngine::OnSetEvent(EventHandler* eh, int old_mask, int new_mask)
 	}
 }
 
-int SocketEngine::DispatchEvents()
+int SocketEngine::DispatchEvents(int timeout)
 {
+	// Don't block waiting for events if there are trial reads or writes waiting.
+	if (!trials.empty())
+		timeout = 0;
+
 	timeval tval;
-	tval.tv_sec = 1;
-	tval.tv_usec = 0;
+	tval.tv_sec = timeout / 1000;
+	tval.tv_usec = (timeout % 1000) * 1000;
 
 	fd_set rfdset = ReadSet, wfdset = WriteSet, errfdset = ErrSet;
 
+	ServerInstance->LoopStats.StartPhase(LoopProfiler::PHASE_WAIT);
 	int sresult = select(MaxFD + 1, &rfdset, &wfdset, &errfdset, &tval);
+	ServerInstance->LoopStats.StartPhase(LoopProfiler::PHASE_DISPATCH);
 	ServerInstance->UpdateTime();
 
 	for (int i = 0, j = sresult; i <= MaxFD && j > 0; i++)
@@ -151,6 +157,7 @@ int SocketEngine::DispatchEvents()
 		if (!ev)
 			continue;
 
+		LoopProfiler::EventTimer timer(ev);
 		if (has_error)
 		{
 			stats.ErrorEvents++;
@@ -26,19 +26,46 @@
 
 #include "inspircd.h"
 
+void Timer::SetTriggerFromNow(std::chrono::milliseconds delay)
+{
+	if (delay.count() < 0)
+		delay = std::chrono::milliseconds::zero();
+
+	trigger = ServerInstance->Time() + std::chrono::duration_cast<std::chrono::seconds>(delay).count();
+	expiry = ServerInstance->MonotonicTime() + delay.count();
+}
+
+void Timer::SetTrigger(time_t nexttrigger)
+{
+	trigger = nexttrigger;
+
+	const time_t secs = nexttrigger - ServerInstance->Time();
+	expiry = ServerInstance->MonotonicTime() + (secs > 0 ? uint64_t(secs) * 1000 : 0);
+}
+
 void Timer::SetInterval(unsigned int newinterval)
+{
+	SetInterval(std::chrono::seconds(newinterval));
+}
+
+void Timer::SetInterval(std::chrono::milliseconds newinterval)
 {
 	ServerInstance->Timers.DelTimer(this);
-	secs = newinterval;
-	SetTrigger(ServerInstance->Time() + newinterval);
+	interval = newinterval;
+	SetTriggerFromNow(newinterval);
 	ServerInstance->Timers.AddTimer(this);
 }
 
 Timer::Timer(unsigned int secs_from_now, bool repeating)
-	: trigger(ServerInstance->Time() + secs_from_now)
-	, secs(secs_from_now)
+	: Timer(std::chrono::seconds(secs_from_now), repeating)
+{
+}
+
+Timer::Timer(std::chrono::milliseconds from_now, bool repeating)
+	: interval(from_now)
 	, repeat(repeating)
 {
+	SetTriggerFromNow(from_now);
 }
 
 Timer::~Timer()
@@ -46,42 +73,183 @@ Timer::~Timer()
 	ServerInstance->Timers.DelTimer(this);
 }
 
+void TimerManager::Schedule(Timer* t)
+{
+	// Timers which have already expired are ticked on the next millisecond.
+	uint64_t expiry = std::max(t->expiry, current);
+	uint64_t delta = expiry - current;
+
+	size_t level = 0;
+	while ((delta >> (SLOT_BITS * (level + 1))) && level < LEVEL_COUNT - 1)
+		level++;
+
+	if (delta >> (SLOT_BITS * (level + 1)))
+	{
+		// The timer expires after the end of the wheel. Put it in the last
+		// slot and it will be moved when that slot is reached.
+		expiry = current + (uint64_t(1) << (SLOT_BITS * LEVEL_COUNT)) - 1;
+	}
+
+	const size_t index = (expiry >> (SLOT_BITS * level)) & (SLOT_COUNT - 1);
+	t->slot = &wheel[level][index];
+	t->level = level;
+	t->slot->push_back(t);
+	levelsizes[level]++;
+}
+
+void TimerManager::Unschedule(Timer* t)
+{
+	if (t->slot != &expired)
+		levelsizes[t->level]--;
+
+	t->slot->erase(t);
+	t->slot = nullptr;
+}
+
+void TimerManager::Cascade(size_t level, size_t index)
+{
+	TimerList& list = wheel[level][index];
+	levelsizes[level] -= list.size();
+
+	// Detach the whole list first as timers which are rescheduled can
+	// end up in the same slot if they expire after the end of the wheel.
+	TimerList timers;
+	std::swap(timers, list);
+	while (!timers.empty())
+	{
+		Timer* t = timers.front();
+		timers.pop_front();
+		Schedule(t);
+	}
+}
+
 void TimerManager::TickTimers(time_t TIME)
 {
-	for (TimerMap::iterator i = Timers.begin(); i != Timers.end(); )
+	const uint64_t now = ServerInstance->MonotonicTime();
+	while (current <= now)
 	{
-		Timer* t = i->second;
-		if (t->GetTrigger() > TIME)
+		// Skip over the milliseconds where nothing can happen. If the lowest
+		// levels are empty then nothing happens until the next slot on the
+		// first non-empty level is reached.
+		size_t level = 0;
+		while (level < LEVEL_COUNT && !levelsizes[level])
+			level++;
+
+		if (level == LEVEL_COUNT)
+		{
+			current = now + 1;
 			break;
+		}
 
-		Timers.erase(i++);
+		if (level)
+		{
+			const unsigned int shift = SLOT_BITS * level;
+			const uint64_t next = ((current + (uint64_t(1) << shift) - 1) >> shift) << shift;
+			if (next > now)
+			{
+				current = now + 1;
+				break;
+			}
+			current = next;
+		}
 
-		if (!t->Tick(TIME))
-			continue;
+		// Move timers down from the upper levels when the level below wraps around.
+		for (size_t cascade = 1; cascade < LEVEL_COUNT; ++cascade)
+		{
+			const unsigned int shift = SLOT_BITS * cascade;
+			if (current & ((uint64_t(1) << shift) - 1))
+				break;
+
+			Cascade(cascade, (current >> shift) & (SLOT_COUNT - 1));
+		}
 
-		if (t->GetRepeat())
+		// Take the timers which expire now off the wheel. They are moved to a
+		// separate list so that they can still be removed whilst being ticked
+		// without anything added during a tick ending up in the same list.
+		TimerList& slot = wheel[0][current & (SLOT_COUNT - 1)];
+		levelsizes[0] -= slot.size();
+		while (!slot.empty())
 		{
-			t->SetTrigger(TIME + t->GetInterval());
-			AddTimer(t);
+			Timer* t = slot.front();
+			slot.pop_front();
+			t->slot = &expired;
+			expired.push_back(t);
+		}
+		current++;
+
+		while (!expired.empty())
+		{
+			Timer* t = expired.front();
+			expired.pop_front();
+			t->slot = nullptr;
+
+			// The timer may delete itself when it is ticked so this has to be read beforehand.
+			const auto interval = t->GetIntervalMs().count();
+			const LoopProfiler::TypeId type = LoopProfiler::GetTypeId(t);
+			const LoopProfiler::TimePoint start = ServerInstance->LoopStats.StartActivity();
+			const bool keep = t->Tick(TIME);
+			ServerInstance->LoopStats.EndActivity(start, [interval, type] {
+				return "timer (" + LoopProfiler::DescribeType(type) + ") with an interval of " + ConvToStr(interval) + "ms";
+			});
+
+			if (!keep)
+				continue;
+
+			if (t->GetRepeat() && !t->slot)
+			{
+				t->SetTriggerFromNow(t->GetIntervalMs());
+				AddTimer(t);
+			}
 		}
 	}
 }
 
-void TimerManager::DelTimer(Timer* t)
+int TimerManager::GetNextTimeout(int maxwait) const
 {
-	std::pair<TimerMap::iterator, TimerMap::iterator> itpair = Timers.equal_range(t->GetTrigger());
+	const uint64_t now = ServerInstance->MonotonicTime();
+	uint64_t next = now + std::max(maxwait, 0);
 
-	for (TimerMap::iterator i = itpair.first; i != itpair.second; ++i)
+	for (size_t level = 0; level < LEVEL_COUNT; ++level)
 	{
-		if (i->second == t)
+		// Slots on this level are processed from the first multiple of the
+		// range of a slot which is not before the next unprocessed millisecond.
+		const unsigned int shift = SLOT_BITS * level;
+		const uint64_t first = (current + (uint64_t(1) << shift) - 1) >> shift;
+		if ((first << shift) >= next)
+			break; // Upper levels can not be processed any sooner.
+
+		if (!levelsizes[level])
+			continue;
+
+		for (uint64_t index = first; index < first + SLOT_COUNT; ++index)
 		{
-			Timers.erase(i);
-			break;
+			if (!wheel[level][index & (SLOT_COUNT - 1)].empty())
+			{
+				next = std::min(next, index << shift);
+				break;
+			}
 		}
 	}
+
+	return next > now ? int(next - now) : 0;
+}
+
+void TimerManager::DelTimer(Timer* t)
+{
+	if (t->slot)
+		Unschedule(t);
 }
 
 void TimerManager::AddTimer(Timer* t)
 {
-	Timers.insert(std::make_pair(t->GetTrigger(), t));
+	if (t->slot)
+		Unschedule(t);
+
+	// Adding a timer to an empty wheel can move it to the current time without
+	// needing to step through the time since the last timer was ticked.
+	const uint64_t now = ServerInstance->MonotonicTime();
+	if (current < now && std::all_of(std::begin(levelsizes), std::end(levelsizes), [](size_t size) { return !size; }))
+		current = now;
+
+	Schedule(t);
 }
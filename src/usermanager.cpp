@@ -199,7 +199,7 @@ void UserManager::AddUser(int socket, ListenSocket* via, irc::sockets::sockaddrs
 	 */
 	New->exempt = (ServerInstance->XLines->MatchesLine("E",New) != NULL);
 
-	BanCacheHit* const b = ServerInstance->BanCache.GetHit(New->GetIPString());
+	BanCacheHit* const b = ServerInstance->BanCache.GetHit(New->client_sa);
 	if (b)
 	{
 		if (!b->Type.empty() && !New->exempt)
@@ -383,15 +383,12 @@ void UserManager::DoBackgroundUserStuff()
 		LocalUser* curr = *i;
 		++i;
 
-		if (curr->CommandFloodPenalty || curr->eh.GetSendQSize())
-		{
-			unsigned int rate = curr->GetClass()->GetCommandRate();
-			if (curr->CommandFloodPenalty > rate)
-				curr->CommandFloodPenalty -= rate;
-			else
-				curr->CommandFloodPenalty = 0;
+		// The penalty is decayed even if it is zero so that penalties added outside
+		// of command processing start decaying from when they were added.
+		const bool throttled = curr->CommandFloodPenalty || curr->eh.GetSendQSize();
+		curr->DecayPenalty();
+		if (throttled)
 			curr->eh.OnDataReady();
-		}
 
 		switch (curr->registered)
 		{
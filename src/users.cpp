@@ -105,6 +105,7 @@ LocalUser::LocalUser(int myfd, irc::sockets::sockaddrs* client, irc::sockets::so
 	, quitting_sendq(false)
 	, lastping(true)
 	, exempt(false)
+	, penaltytimer(this)
 {
 	signon = ServerInstance->Time();
 	// The user's default nick is their UUID
@@ -119,6 +120,7 @@ LocalUser::LocalUser(int myfd, irc::sockets::sockaddrs* client, irc::sockets::so
 LocalUser::LocalUser(int myfd, const std::string& uid, Serializable::Data& data)
 	: User(uid, ServerInstance->FakeClient->server, User::TYPE_LOCAL)
 	, eh(this)
+	, penaltytimer(this)
 {
 	eh.SetFd(myfd);
 	Deserialize(data);
@@ -226,19 +228,69 @@ bool LocalUser::HasSnomaskPermission(char chr) const
 	return this->oper->AllowedSnomasks[chr - 'A'];
 }
 
-void UserIOHandler::OnDataReady()
+void UserIOHandler::CompactRecvQ()
 {
-	if (user->quitting)
+	if (!recvq_start)
 		return;
 
+	// Lines which have already been processed are only removed from the recvq
+	// once per batch of lines so the remaining data is only moved once.
+	recvq.erase(0, recvq_start);
+	checked_until -= recvq_start;
+	recvq_start = 0;
+	CountRecvQ();
+}
+
+bool UserIOHandler::CheckRecvQ()
+{
 	if (recvq.length() > user->GetClass()->GetRecvqMax() && !user->HasPrivPermission("users/flood/increased-buffers"))
 	{
 		ServerInstance->Users.QuitUser(user, "RecvQ exceeded");
 		ServerInstance->SNO.WriteToSnoMask('a', "User %s RecvQ of %zu exceeds connect class maximum of %lu",
 			user->nick.c_str(), recvq.length(), user->GetClass()->GetRecvqMax());
+		return false;
+	}
+	return true;
+}
+
+bool PenaltyTimer::Tick(time_t currtime)
+{
+	user->eh.OnDataReady();
+	return true;
+}
+
+void LocalUser::DecayPenalty()
+{
+	const uint64_t now = ServerInstance->MonotonicTime();
+	if (!CommandFloodPenalty)
+	{
+		lastpenaltydecay = now;
 		return;
 	}
 
+	const uint64_t rate = GetClass()->GetCommandRate();
+	const uint64_t decay = (now - lastpenaltydecay) * rate / 1000;
+	if (decay >= CommandFloodPenalty)
+	{
+		CommandFloodPenalty = 0;
+		lastpenaltydecay = now;
+	}
+	else if (decay)
+	{
+		// Only move forward by the time that was used up so that the remainder
+		// counts towards the next decay.
+		CommandFloodPenalty -= decay;
+		lastpenaltydecay += decay * 1000 / rate;
+	}
+}
+
+void UserIOHandler::OnDataReady()
+{
+	if (user->quitting)
+		return;
+
+	user->DecayPenalty();
+
 	unsigned long sendqmax = ULONG_MAX;
 	if (!user->HasPrivPermission("users/flood/increased-buffers"))
 		sendqmax = user->GetClass()->GetSendqSoftMax();
@@ -247,64 +299,73 @@ void UserIOHandler::OnDataReady()
 	if (!user->HasPrivPermission("users/flood/no-fakelag"))
 		penaltymax = user->GetClass()->GetPenaltyThreshold() * 1000;
 
-	// The cleaned message sent by the user or empty if not found yet.
-	std::string line;
-
-	// The position of the most \n character or npos if not found yet.
-	std::string::size_type eolpos;
-
-	// The position within the recvq of the current character.
-	std::string::size_type qpos;
-
 	while (user->CommandFloodPenalty < penaltymax && GetSendQSize() < sendqmax)
 	{
 		// Check the newly received data for an EOL.
-		eolpos = recvq.find('\n', checked_until);
+		const std::string::size_type eolpos = recvq.find('\n', checked_until);
 		if (eolpos == std::string::npos)
 		{
+			// Everything that has been received so far has been processed so
+			// we can start reading from the user again if we had stopped. If
+			// what is left is too long to be a line then they are flooding.
+			CompactRecvQ();
 			checked_until = recvq.length();
+			if (CheckRecvQ())
+				ResumeReading();
 			return;
 		}
 
-		// We've found a line! Clean it up and move it to the line buffer.
-		line.reserve(eolpos);
-		for (qpos = 0; qpos < eolpos; ++qpos)
-		{
-			char c = recvq[qpos];
-			switch (c)
-			{
-				case '\0':
-					c = ' ';
-					break;
-				case '\r':
-					continue;
-			}
-
-			line.push_back(c);
-		}
-
-		// just found a newline. Terminate the string, and pull it out of recvq
-		recvq.erase(0, eolpos + 1);
-		checked_until = 0;
+		// We've found a line! Clean it up in place within the recvq.
+		const std::string::size_type linesize = eolpos - recvq_start;
+		const std::string_view line(recvq.data() + recvq_start, CleanLine(&recvq[recvq_start], linesize));
+		recvq_start = checked_until = eolpos + 1;
 
 		// TODO should this be moved to when it was inserted in recvq?
-		ServerInstance->stats.Recv += qpos;
-		user->bytes_in += qpos;
+		ServerInstance->stats.Recv += linesize;
+		user->bytes_in += linesize;
 		user->cmds_in++;
 
 		ServerInstance->Parser.ProcessBuffer(user, line);
 		if (user->quitting)
 			return;
-
-		// clear() does not reclaim memory associated with the string, so our .reserve() call is safe
-		line.clear();
 	}
 
+	CompactRecvQ();
 	if (user->CommandFloodPenalty >= penaltymax && !user->GetClass()->fakelag)
+	{
 		ServerInstance->Users.QuitUser(user, "Excess Flood");
+		return;
+	}
+
+	// The user is being throttled. There is no point in reading any more data
+	// from them until their penalty has decayed or their sendq has drained so
+	// leave it in the kernel buffer until then. As reading is only resumed once
+	// every complete line has been processed the recvq can not grow by more
+	// than one read past the limit whilst the user is being throttled.
+	PauseReading();
+
+	// If the penalty is what is throttling the user then process them again
+	// as soon as it has decayed enough rather than at the next background check.
+	if (user->CommandFloodPenalty >= penaltymax)
+	{
+		const uint64_t rate = user->GetClass()->GetCommandRate();
+		const uint64_t excess = user->CommandFloodPenalty - penaltymax + 1;
+		user->penaltytimer.SetInterval(std::chrono::milliseconds((excess * 1000 + rate - 1) / rate));
+	}
+}
+
+void UserIOHandler::OnEventHandlerWrite()
+{
+	StreamSocket::OnEventHandlerWrite();
+
+	// If the user was throttled because their sendq was full then process them
+	// again once it has drained below the low watermark instead of waiting for
+	// the next background check.
+	if (IsReadingPaused() && !user->quitting && GetSendQSize() <= user->GetClass()->GetSendqSoftMax() / 2)
+		OnDataReady();
 }
 
-void UserIOHandler::AddWriteBuf(const std::string &data)
+void UserIOHandler::AddWriteBuf(const SendQueue::Element& data)
 {
 	if (user->quitting_sendq)
 		return;
@@ -326,6 +387,7 @@ void UserIOHandler::SwapInternals(UserIOHandler& other)
 {
 	StreamSocket::SwapInternals(other);
 	std::swap(checked_until, other.checked_until);
+	std::swap(recvq_start, other.recvq_start);
 }
 
 bool UserIOHandler::OnSetLocalEndPoint(const irc::sockets::sockaddrs& ep)
@@ -587,7 +649,7 @@ void LocalUser::FullConnect()
 	ServerInstance->SNO.WriteToSnoMask('c',"Client connecting on port %d (class %s): %s (%s) [%s]",
 		this->server_sa.port(), this->GetClass()->name.c_str(), GetFullRealHost().c_str(), this->GetIPString().c_str(), this->GetRealName().c_str());
 	ServerInstance->Logs.Log("BANCACHE", LOG_DEBUG, "BanCache: Adding NEGATIVE hit for " + this->GetIPString());
-	ServerInstance->BanCache.AddHit(this->GetIPString(), "", "");
+	ServerInstance->BanCache.AddHit(this->client_sa, "", "");
 	// reset the flood penalty (which could have been raised due to things like auto +x)
 	CommandFloodPenalty = 0;
 }
@@ -595,6 +657,7 @@ void LocalUser::FullConnect()
 void User::InvalidateCache()
 {
 	/* Invalidate cache */
+	maskgeneration++;
 	cachedip.clear();
 	cached_fullhost.clear();
 	cached_hostip.clear();
@@ -790,11 +853,11 @@ void LocalUser::Write(const ClientProtocol::SerializedMessage& text)
 		if (text.empty())
 			return;
 
-		std::string::size_type nlpos = text.find_first_of("\r\n", 0, 2);
-		if (nlpos == std::string::npos)
+		std::string_view::size_type nlpos = text.view().find_first_of("\r\n");
+		if (nlpos == std::string_view::npos)
 			nlpos = text.length(); // TODO is this ok, test it
 
-		ServerInstance->Logs.Log("USEROUTPUT", LOG_RAWIO, "C[%s] O %.*s", uuid.c_str(), static_cast<int>(nlpos), text.c_str());
+		ServerInstance->Logs.Log("USEROUTPUT", LOG_RAWIO, "C[%s] O %.*s", uuid.c_str(), static_cast<int>(nlpos), text.data());
 	}
 
 	eh.AddWriteBuf(text);
@@ -933,11 +996,11 @@ void User::ForEachNeighbor(ForEachNeighborHandler& handler, bool include_self)
 	// Now consider the real neighbors
 	for (const auto* memb : include_chans)
 	{
-		for (const auto& [user, _] : memb->chan->GetUsers())
+		for (const auto& member : memb->chan->GetLocalMembers())
 		{
-			LocalUser* curr = IS_LOCAL(user);
+			LocalUser* curr = static_cast<LocalUser*>(member.user);
 			// User not yet visited?
-			if ((curr) && (curr->already_sent != newid))
+			if (curr->already_sent != newid)
 			{
 				// Mark as visited and execute function
 				curr->already_sent = newid;
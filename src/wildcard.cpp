@@ -110,6 +110,176 @@ bool InspIRCd::MatchCIDR(const char* str, const char* mask, unsigned const char*
 	return InspIRCd::Match(str, mask, map);
 }
 
+CompiledMask::CompiledMask(const std::string& pattern, const unsigned char* casemap)
+	: mask(pattern)
+	, map(casemap ? casemap : national_case_insensitive_map)
+{
+	folded.reserve(mask.length());
+	for (std::string::size_type pos = 0; pos < mask.length(); )
+	{
+		if (mask[pos] == '*')
+		{
+			if (!pos)
+				leadingstar = true;
+			trailingstar = true;
+			pos++;
+			continue;
+		}
+
+		// Everything up to the next '*' (or the end of the pattern) is a segment.
+		Segment segment = { folded.length(), 0, -1 };
+		for (; pos < mask.length() && mask[pos] != '*'; ++pos)
+		{
+			const unsigned char chr = mask[pos];
+			folded.push_back(chr == '?' ? '?' : map[chr]);
+			segment.length++;
+		}
+
+		// If only one character folds to the first character of the segment then
+		// we can search for it with memchr instead of examining every character.
+		const unsigned char first = folded[segment.start];
+		if (first != '?')
+		{
+			for (unsigned int chr = 0; chr <= UCHAR_MAX; ++chr)
+			{
+				if (map[chr] != first)
+					continue;
+
+				if (segment.anchor != -1)
+				{
+					segment.anchor = -1;
+					break;
+				}
+				segment.anchor = chr;
+			}
+		}
+
+		minlength += segment.length;
+		segments.push_back(segment);
+		trailingstar = false;
+	}
+}
+
+bool CompiledMask::MatchSegment(const char* str, const Segment& segment) const
+{
+	const char* pattern = folded.data() + segment.start;
+	for (size_t pos = 0; pos < segment.length; ++pos)
+	{
+		if (pattern[pos] != '?' && static_cast<char>(map[static_cast<unsigned char>(str[pos])]) != pattern[pos])
+			return false;
+	}
+	return true;
+}
+
+size_t CompiledMask::FindSegment(std::string_view str, size_t pos, const Segment& segment) const
+{
+	if (str.length() < segment.length)
+		return std::string_view::npos;
+
+	const size_t last = str.length() - segment.length;
+	for (; pos <= last; ++pos)
+	{
+		if (segment.anchor != -1)
+		{
+			const void* found = memchr(str.data() + pos, segment.anchor, last - pos + 1);
+			if (!found)
+				return std::string_view::npos;
+
+			pos = static_cast<const char*>(found) - str.data();
+		}
+
+		if (MatchSegment(str.data() + pos, segment))
+			return pos;
+	}
+	return std::string_view::npos;
+}
+
+bool CompiledMask::Match(std::string_view str) const
+{
+	if (str.length() < minlength)
+		return false;
+
+	if (segments.empty())
+		return leadingstar || str.empty();
+
+	size_t pos = 0;
+	for (size_t idx = 0; idx < segments.size(); ++idx)
+	{
+		const Segment& segment = segments[idx];
+		const bool first = !idx && !leadingstar;
+		const bool last = idx + 1 == segments.size() && !trailingstar;
+
+		if (first && last)
+		{
+			// There are no stars so the string must match exactly.
+			return str.length() == segment.length && MatchSegment(str.data(), segment);
+		}
+
+		if (first)
+		{
+			// The string must start with the first segment.
+			if (!MatchSegment(str.data(), segment))
+				return false;
+
+			pos = segment.length;
+			continue;
+		}
+
+		if (last)
+		{
+			// The string must end with the last segment without overlapping the previous one.
+			if (str.length() - pos < segment.length)
+				return false;
+
+			return MatchSegment(str.data() + str.length() - segment.length, segment);
+		}
+
+		// Any other segment can appear anywhere after the previous one. Matching the
+		// earliest occurrence always leaves the most room for the remaining segments.
+		pos = FindSegment(str, pos, segment);
+		if (pos == std::string_view::npos)
+			return false;
+
+		pos += segment.length;
+	}
+
+	return true;
+}
+
+bool CompiledMask::MatchCIDR(const std::string& str) const
+{
+	if (irc::sockets::MatchCIDR(str, mask, true))
+		return true;
+
+	// Fall back to regular match
+	return Match(str);
+}
+
+namespace
+{
+	// This is a direct mapped cache so looking up a pattern which is already
+	// cached never allocates. A collision simply replaces the older pattern.
+	std::array<std::shared_ptr<const CompiledMask>, 1024> cache;
+}
+
+void CompiledMask::ClearCache()
+{
+	for (auto& entry : cache)
+		entry.reset();
+}
+
+std::shared_ptr<const CompiledMask> CompiledMask::Get(std::string_view pattern, const unsigned char* casemap)
+{
+	if (!casemap)
+		casemap = national_case_insensitive_map;
+
+	const size_t hash = std::hash<std::string_view>()(pattern) ^ std::hash<const void*>()(casemap);
+	std::shared_ptr<const CompiledMask>& entry = cache[hash % cache.size()];
+	if (!entry || entry->GetMap() != casemap || entry->GetMask() != pattern)
+		entry = std::make_shared<const CompiledMask>(std::string(pattern), casemap);
+	return entry;
+}
+
 bool InspIRCd::MatchMask(const std::string& masks, const std::string& hostname, const std::string& ipaddr)
 {
 	irc::spacesepstream masklist(masks);
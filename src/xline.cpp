@@ -109,6 +109,223 @@ class ZLineFactory : public XLineFactory
 };
 
 
+namespace
+{
+	/** The ways in which the host mask of an X-line can be indexed. */
+	enum class HostMaskType
+	{
+		/** The line has no host mask or its host mask can not be indexed. */
+		OTHER,
+
+		/** The host mask is a literal host. */
+		EXACT,
+
+		/** The host mask is a literal host suffix prefixed with a '*'. */
+		SUFFIX,
+
+		/** The host mask is a CIDR range. */
+		RANGE
+	};
+
+	/** Determines whether a character can appear in an indexed host mask. These characters are
+	 * never folded differently by any case map so the mask can be compared with the ASCII one.
+	 */
+	bool IsIndexableHostChar(unsigned char chr)
+	{
+		return (chr >= '0' && chr <= '9') || (chr >= 'A' && chr <= 'Z') || (chr >= 'a' && chr <= 'z')
+			|| chr == '-' || chr == '.' || chr == ':' || chr == '_';
+	}
+
+	/** Folds a host so that it can be looked up in an index. */
+	std::string FoldHost(std::string_view host)
+	{
+		std::string folded;
+		folded.reserve(host.length());
+		for (const auto chr : host)
+			folded.push_back(ascii_case_insensitive_map[static_cast<unsigned char>(chr)]);
+		return folded;
+	}
+
+	/** Determines how the host mask of an X-line can be indexed.
+	 * @param line The line to examine.
+	 * @param key If the type is EXACT or SUFFIX then the location to store the folded host.
+	 * @param range If the type is RANGE then the location to store the CIDR range.
+	 */
+	HostMaskType ClassifyHostMask(const XLine* line, std::string& key, irc::sockets::cidr_mask& range)
+	{
+		const std::string* mask = line->GetHostMask();
+		if (!mask || mask->empty())
+			return HostMaskType::OTHER;
+
+		const std::string::size_type slash = mask->rfind('/');
+		if (slash != std::string::npos)
+		{
+			// This must reject all of the masks which irc::sockets::MatchCIDR does.
+			if (slash == mask->length() - 1 || mask->find_first_not_of("0123456789", slash + 1) != std::string::npos
+				|| mask->find_first_not_of("0123456789abcdefABCDEF.:") < slash)
+				return HostMaskType::OTHER;
+
+			irc::sockets::sockaddrs sa;
+			if (!irc::sockets::aptosa(mask->substr(0, slash), 0, sa))
+				return HostMaskType::OTHER;
+
+			range = irc::sockets::cidr_mask(*mask);
+			return HostMaskType::RANGE;
+		}
+
+		const bool suffix = (*mask)[0] == '*';
+		if (suffix && mask->length() == 1)
+			return HostMaskType::OTHER;
+
+		for (std::string::size_type pos = suffix ? 1 : 0; pos < mask->length(); ++pos)
+		{
+			if (!IsIndexableHostChar((*mask)[pos]))
+				return HostMaskType::OTHER;
+		}
+
+		key = FoldHost(std::string_view(*mask).substr(suffix ? 1 : 0));
+		return suffix ? HostMaskType::SUFFIX : HostMaskType::EXACT;
+	}
+}
+
+void XLineIndex::Add(XLine* line)
+{
+	std::string key;
+	irc::sockets::cidr_mask range;
+	switch (ClassifyHostMask(line, key, range))
+	{
+		case HostMaskType::EXACT:
+			exact[key].push_back(line);
+			break;
+
+		case HostMaskType::SUFFIX:
+			suffixlengths[key.length()]++;
+			suffixes[key].push_back(line);
+			break;
+
+		case HostMaskType::RANGE:
+			rangelengths[std::make_pair(range.type, range.length)]++;
+			ranges[range].push_back(line);
+			break;
+
+		case HostMaskType::OTHER:
+			other.push_back(line);
+			break;
+	}
+}
+
+void XLineIndex::Remove(XLine* line)
+{
+	std::string key;
+	irc::sockets::cidr_mask range;
+	switch (ClassifyHostMask(line, key, range))
+	{
+		case HostMaskType::EXACT:
+		{
+			auto it = exact.find(key);
+			if (it != exact.end() && stdalgo::vector::swaperase(it->second, line) && it->second.empty())
+				exact.erase(it);
+			break;
+		}
+
+		case HostMaskType::SUFFIX:
+		{
+			auto it = suffixes.find(key);
+			if (it == suffixes.end() || !stdalgo::vector::swaperase(it->second, line))
+				break;
+
+			if (it->second.empty())
+				suffixes.erase(it);
+
+			auto lit = suffixlengths.find(key.length());
+			if (!--lit->second)
+				suffixlengths.erase(lit);
+			break;
+		}
+
+		case HostMaskType::RANGE:
+		{
+			auto it = ranges.find(range);
+			if (it == ranges.end() || !stdalgo::vector::swaperase(it->second, line))
+				break;
+
+			if (it->second.empty())
+				ranges.erase(it);
+
+			auto lit = rangelengths.find(std::make_pair(range.type, range.length));
+			if (!--lit->second)
+				rangelengths.erase(lit);
+			break;
+		}
+
+		case HostMaskType::OTHER:
+			stdalgo::vector::swaperase(other, line);
+			break;
+	}
+}
+
+void XLineIndex::FindHost(const std::string& host, LineList& out) const
+{
+	const std::string folded = FoldHost(host);
+	auto it = exact.find(folded);
+	if (it != exact.end())
+		out.insert(out.end(), it->second.begin(), it->second.end());
+
+	for (const auto& [length, _] : suffixlengths)
+	{
+		if (length > folded.length())
+			break;
+
+		it = suffixes.find(folded.substr(folded.length() - length));
+		if (it != suffixes.end())
+			out.insert(out.end(), it->second.begin(), it->second.end());
+	}
+
+	// A CIDR range which does not match as a range is matched as a glob
+	// pattern instead so it can match a host which is identical to it.
+	if (host.find('/') != std::string::npos)
+	{
+		for (const auto& [_, lines] : ranges)
+			out.insert(out.end(), lines.begin(), lines.end());
+	}
+}
+
+void XLineIndex::FindRange(const irc::sockets::sockaddrs& sa, LineList& out) const
+{
+	for (const auto& [typelength, _] : rangelengths)
+	{
+		if (typelength.first != sa.family())
+			continue;
+
+		auto it = ranges.find(irc::sockets::cidr_mask(sa, typelength.second));
+		if (it != ranges.end())
+			out.insert(out.end(), it->second.begin(), it->second.end());
+	}
+}
+
+void XLineIndex::Find(User* user, std::vector<XLine*>& out) const
+{
+	const size_t start = out.size();
+	out.insert(out.end(), other.begin(), other.end());
+
+	const std::string& realhost = user->GetRealHost();
+	const std::string& ip = user->GetIPString();
+	FindHost(realhost, out);
+	FindRange(user->client_sa, out);
+	if (realhost != ip)
+	{
+		FindHost(ip, out);
+
+		irc::sockets::sockaddrs sa;
+		if (!rangelengths.empty() && irc::sockets::aptosa(realhost, 0, sa))
+			FindRange(sa, out);
+	}
+
+	// A line can be found by both the real host and the IP address.
+	std::sort(out.begin() + start, out.end());
+	out.erase(std::unique(out.begin() + start, out.end()), out.end());
+}
+
 /*
  * This is now version 3 of the XLine subsystem, let's see if we can get it as nice and
  * efficient as we can this time so we can close this file and never ever touch it again ..
@@ -151,45 +368,21 @@ bool XLine::Matches(User *u)
  */
 void XLineManager::CheckELines()
 {
-	ContainerIter n = lookup_lines.find("E");
-
-	if (n == lookup_lines.end())
-		return;
-
-	XLineLookup& ELines = n->second;
-
-	if (ELines.empty())
-		return;
-
-	for (auto* u :  ServerInstance->Users.GetLocalUsers())
-	{
-		u->exempt = false;
-
-		/* This uses safe iteration to ensure that if a line expires here, it doenst trash the iterator */
-		LookupIter safei;
-
-		for (LookupIter i = ELines.begin(); i != ELines.end(); )
-		{
-			safei = i;
-			safei++;
-
-			XLine *e = i->second;
-			if ((!e->duration || ServerInstance->Time() < e->expiry) && e->Matches(u))
-				u->exempt = true;
-
-			i = safei;
-		}
-	}
+	apply_action.queuedexemptcheck = true;
+	ServerInstance->IncrementalActions.AddAction(&apply_action);
 }
 
 
-XLineLookup* XLineManager::GetAll(const std::string &type)
+XLineLookup* XLineManager::GetAll(const std::string &type, bool expire)
 {
 	ContainerIter n = lookup_lines.find(type);
 
 	if (n == lookup_lines.end())
 		return NULL;
 
+	if (!expire)
+		return &(n->second);
+
 	LookupIter safei;
 	const time_t current = ServerInstance->Time();
 
@@ -208,6 +401,12 @@ XLineLookup* XLineManager::GetAll(const std::string &type)
 	return &(n->second);
 }
 
+size_t XLineManager::GetCount(const std::string& type) const
+{
+	XLineContainer::const_iterator n = lookup_lines.find(type);
+	return n == lookup_lines.end() ? 0 : n->second.size();
+}
+
 void XLineManager::DelAll(const std::string &type)
 {
 	ContainerIter n = lookup_lines.find(type);
@@ -307,6 +506,7 @@ bool XLineManager::AddLine(XLine* line, User* user)
 		pending_lines.push_back(line);
 
 	lookup_lines[line->type][line->Displayable()] = line;
+	line_index[line->type].Add(line);
 	line->OnAdd();
 
 	FOREACH_MOD(OnAddLine, (user, line));
@@ -340,6 +540,8 @@ bool XLineManager::DelLine(const char* hostmask, const std::string& type, std::s
 	y->second->Unset();
 
 	stdalgo::erase(pending_lines, y->second);
+	apply_action.Remove(y->second);
+	line_index[type].Remove(y->second);
 
 	delete y->second;
 	x->second.erase(y);
@@ -364,29 +566,26 @@ XLine* XLineManager::MatchesLine(const std::string &type, User* user)
 
 	const time_t current = ServerInstance->Time();
 
-	LookupIter safei;
+	std::vector<XLine*> candidates;
+	line_index[type].Find(user, candidates);
 
-	for (LookupIter i = x->second.begin(); i != x->second.end(); )
+	// If more than one line matches then return the one which is first in
+	// the lookup map so that the result does not depend on the index.
+	XLine* match = NULL;
+	const XLineLookup::key_compare comp = x->second.key_comp();
+	for (auto* candidate : candidates)
 	{
-		safei = i;
-		safei++;
-
-		if (i->second->duration && current > i->second->expiry)
+		if (candidate->duration && current > candidate->expiry)
 		{
 			/* Expire the line, proceed to next one */
-			ExpireLine(x, i);
-			i = safei;
+			ExpireLine(x, x->second.find(candidate->Displayable()));
 			continue;
 		}
 
-		if (i->second->Matches(user))
-		{
-			return i->second;
-		}
-
-		i = safei;
+		if ((!match || comp(candidate->Displayable(), match->Displayable())) && candidate->Matches(user))
+			match = candidate;
 	}
-	return NULL;
+	return match;
 }
 
 XLine* XLineManager::MatchesLine(const std::string &type, const std::string &pattern)
@@ -439,6 +638,8 @@ void XLineManager::ExpireLine(ContainerIter container, LookupIter item, bool sil
 	 * -- Brain
 	 */
 	stdalgo::erase(pending_lines, item->second);
+	apply_action.Remove(item->second);
+	line_index[container->first].Remove(item->second);
 
 	delete item->second;
 	container->second.erase(item);
@@ -448,30 +649,105 @@ void XLineManager::ExpireLine(ContainerIter container, LookupIter item, bool sil
 // applies lines, removing clients and changing nicks etc as applicable
 void XLineManager::ApplyLines()
 {
-	const UserManager::LocalList& list = ServerInstance->Users.GetLocalUsers();
-	for (UserManager::LocalList::const_iterator j = list.begin(); j != list.end(); )
+	if (pending_lines.empty())
+		return;
+
+	apply_action.queued.insert(apply_action.queued.end(), pending_lines.begin(), pending_lines.end());
+	pending_lines.clear();
+	ServerInstance->IncrementalActions.AddAction(&apply_action);
+}
+
+void XLineManager::ApplyAction::Remove(XLine* line)
+{
+	stdalgo::erase(queued, line);
+	if (stdalgo::erase(lines, line))
 	{
-		LocalUser* u = *j++;
+		order.erase(line);
+		index.Remove(line);
+	}
+}
 
-		// Don't ban people who are exempt.
-		if (u->exempt)
-			continue;
+void XLineManager::ApplyAction::ApplyToUser(LocalUser* u)
+{
+	if (exemptcheck)
+		u->exempt = (ServerInstance->XLines->MatchesLine("E", u) != NULL);
+
+	// Don't ban people who are exempt.
+	if (u->exempt || lines.empty())
+		return;
+
+	std::vector<XLine*> candidates;
+	index.Find(u, candidates);
+
+	// Apply the lines in the order they were added.
+	std::sort(candidates.begin(), candidates.end(), [this](XLine* lhs, XLine* rhs) {
+		return order[lhs] < order[rhs];
+	});
 
-		for (const auto& x : pending_lines)
+	for (const auto& x : candidates)
+	{
+		if (x->Matches(u))
 		{
-			if (x->Matches(u))
-			{
-				x->Apply(u);
+			x->Apply(u);
 
-				// If applying the X-line has killed the user then don't
-				// apply any more lines to them.
-				if (u->quitting)
-					break;
-			}
+			// If applying the X-line has killed the user then don't
+			// apply any more lines to them.
+			if (u->quitting)
+				break;
 		}
 	}
+}
 
-	pending_lines.clear();
+bool XLineManager::ApplyAction::Step()
+{
+	if (!running)
+	{
+		if (queued.empty() && !queuedexemptcheck)
+			return false;
+
+		// Start a new pass with everything that has been queued. Anything which
+		// is queued after this will wait until this pass has finished so that
+		// it is applied to every user.
+		lines.swap(queued);
+		for (auto* x : lines)
+		{
+			index.Add(x);
+			order.emplace(x, order.size());
+		}
+
+		exemptcheck = queuedexemptcheck;
+		queuedexemptcheck = false;
+
+		users.reserve(ServerInstance->Users.GetLocalUsers().size());
+		for (const auto* u : ServerInstance->Users.GetLocalUsers())
+			users.push_back(u->uuid);
+
+		position = 0;
+		running = true;
+	}
+
+	// Users which connect after the pass has started are checked against all
+	// of the lines when they connect so only the users which existed when the
+	// pass started need to be visited. They are looked up by UUID as they may
+	// have quit in an earlier step.
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(5);
+	for (size_t processed = 1; position < users.size(); ++processed)
+	{
+		LocalUser* u = IS_LOCAL(ServerInstance->Users.FindUUID(users[position++]));
+		if (u && !u->quitting)
+			ApplyToUser(u);
+
+		if (!(processed % 64) && std::chrono::steady_clock::now() >= deadline)
+			return true;
+	}
+
+	lines.clear();
+	order.clear();
+	index = XLineIndex();
+	users.clear();
+	users.shrink_to_fit();
+	running = false;
+	return !queued.empty() || queuedexemptcheck;
 }
 
 bool XLineManager::InvokeStats(const std::string& type, Stats::Context& context)
@@ -523,6 +799,8 @@ XLineManager::XLineManager()
 
 XLineManager::~XLineManager()
 {
+	ServerInstance->IncrementalActions.DelAction(&apply_action);
+
 	const char gekqz[] = "GEKQZ";
 	for(unsigned int i=0; i < sizeof(gekqz); i++)
 	{
@@ -563,7 +841,7 @@ void XLine::DefaultApply(User* u, const std::string &line, bool bancache)
 	if (bancache)
 	{
 		ServerInstance->Logs.Log("BANCACHE", LOG_DEBUG, "BanCache: Adding positive hit (" + line + ") for " + u->GetIPString());
-		ServerInstance->BanCache.AddHit(u->GetIPString(), this->type, banReason, (this->duration > 0 ? (this->expiry - ServerInstance->Time()) : 0));
+		ServerInstance->BanCache.AddHit(u->client_sa, this->type, banReason, (this->duration > 0 ? (this->expiry - ServerInstance->Time()) : 0));
 	}
 }
 
@@ -573,10 +851,9 @@ bool KLine::Matches(User *u)
 	if (lu && lu->exempt)
 		return false;
 
-	if (InspIRCd::Match(u->ident, this->identmask, ascii_case_insensitive_map))
+	if (identmatch.Match(u->ident))
 	{
-		if (InspIRCd::MatchCIDR(u->GetRealHost(), this->hostmask, ascii_case_insensitive_map) ||
-			InspIRCd::MatchCIDR(u->GetIPString(), this->hostmask, ascii_case_insensitive_map))
+		if (hostmatch.MatchCIDR(u->GetRealHost()) || hostmatch.MatchCIDR(u->GetIPString()))
 		{
 			return true;
 		}
@@ -596,10 +873,9 @@ bool GLine::Matches(User *u)
 	if (lu && lu->exempt)
 		return false;
 
-	if (InspIRCd::Match(u->ident, this->identmask, ascii_case_insensitive_map))
+	if (identmatch.Match(u->ident))
 	{
-		if (InspIRCd::MatchCIDR(u->GetRealHost(), this->hostmask, ascii_case_insensitive_map) ||
-			InspIRCd::MatchCIDR(u->GetIPString(), this->hostmask, ascii_case_insensitive_map))
+		if (hostmatch.MatchCIDR(u->GetRealHost()) || hostmatch.MatchCIDR(u->GetIPString()))
 		{
 			return true;
 		}
@@ -615,10 +891,9 @@ void GLine::Apply(User* u)
 
 bool ELine::Matches(User *u)
 {
-	if (InspIRCd::Match(u->ident, this->identmask, ascii_case_insensitive_map))
+	if (identmatch.Match(u->ident))
 	{
-		if (InspIRCd::MatchCIDR(u->GetRealHost(), this->hostmask, ascii_case_insensitive_map) ||
-			InspIRCd::MatchCIDR(u->GetIPString(), this->hostmask, ascii_case_insensitive_map))
+		if (hostmatch.MatchCIDR(u->GetRealHost()) || hostmatch.MatchCIDR(u->GetIPString()))
 		{
 			return true;
 		}
@@ -633,7 +908,9 @@ bool ZLine::Matches(User *u)
 	if (lu && lu->exempt)
 		return false;
 
-	if (InspIRCd::MatchCIDR(u->GetIPString(), this->ipaddr))
+	// The national case map can change at runtime so the compiled mask is
+	// looked up from the cache rather than being stored in the line.
+	if (CompiledMask::Get(this->ipaddr)->MatchCIDR(u->GetIPString()))
 		return true;
 	else
 		return false;
@@ -647,7 +924,7 @@ void ZLine::Apply(User* u)
 
 bool QLine::Matches(User *u)
 {
-	if (InspIRCd::Match(u->nick, this->nick))
+	if (CompiledMask::Get(this->nick)->Match(u->nick))
 		return true;
 
 	return false;
@@ -694,12 +971,7 @@ bool GLine::Matches(const std::string &str)
 
 void ELine::OnAdd()
 {
-	/* When adding one E-line, only check the one E-line */
-	for (auto* u : ServerInstance->Users.GetLocalUsers())
-	{
-		if (this->Matches(u))
-			u->exempt = true;
-	}
+	ServerInstance->XLines->CheckELines();
 }
 
 void XLine::DisplayExpiry()
@@ -0,0 +1,184 @@
+/*
+ * InspIRCd -- Internet Relay Chat Daemon
+ *
+ * This file is part of InspIRCd.  InspIRCd is free software: you can
+ * redistribute it and/or modify it under the terms of the GNU General Public
+ * License as published by the Free Software Foundation, version 2.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Benchmarks the kernels behind FindLineControl() and CleanLine() against the
+ * byte at a time loop which UserIOHandler::OnDataReady() used to clean up lines
+ * with. This is not built with the rest of the server. To build and run it:
+ *
+ *   c++ -O2 -std=c++17 -Iinclude tools/bench-linescan.cpp -o bench-linescan
+ *   ./bench-linescan [CAPTURE] [ITERATIONS]
+ *
+ * CAPTURE is a file containing the raw bytes which were received from clients,
+ * for example the payload of a packet capture of port 6667. If it is not given
+ * then a capture of PRIVMSGs of various lengths is generated.
+ */
+
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "utility/linescan.h"
+
+namespace
+{
+	/** The loop which cleaned up lines before the kernels were introduced. */
+	size_t CleanOld(char* data, size_t len)
+	{
+		size_t linelen = 0;
+		for (size_t pos = 0; pos < len; ++pos)
+		{
+			char c = data[pos];
+			switch (c)
+			{
+				case '\0':
+					c = ' ';
+					break;
+				case '\r':
+					continue;
+			}
+
+			data[linelen++] = c;
+		}
+		return linelen;
+	}
+
+	std::string GenerateCapture()
+	{
+		std::string capture;
+		unsigned int seed = 1;
+		for (size_t line = 0; line < 20000; ++line)
+		{
+			seed = seed * 1103515245 + 12345;
+			capture.append("PRIVMSG #channel :");
+			capture.append(10 + (seed >> 16) % 480, 'a' + line % 26);
+
+			// Some clients send stray null characters.
+			if (line % 1000 == 0)
+				capture.push_back('\0');
+			capture.append("\r\n");
+		}
+		return capture;
+	}
+
+	std::vector<std::string> SplitLines(const std::string& capture)
+	{
+		std::vector<std::string> lines;
+		size_t start = 0;
+		for (size_t eol = capture.find('\n'); eol != std::string::npos; eol = capture.find('\n', start))
+		{
+			lines.push_back(capture.substr(start, eol - start));
+			start = eol + 1;
+		}
+		return lines;
+	}
+
+	template <typename Cleaner>
+	void Run(const char* name, const std::vector<std::string>& lines, size_t bytes, unsigned long iterations,
+		const std::vector<std::string>& expected, Cleaner&& clean)
+	{
+		std::vector<std::string> work;
+		std::chrono::steady_clock::duration total{};
+		for (unsigned long iteration = 0; iteration < iterations; ++iteration)
+		{
+			work = lines;
+			const auto start = std::chrono::steady_clock::now();
+			for (auto& line : work)
+				line.resize(clean(line.data(), line.size()));
+			total += std::chrono::steady_clock::now() - start;
+		}
+
+		if (!expected.empty() && work != expected)
+		{
+			fprintf(stderr, "%s produced different output to the old loop!\n", name);
+			exit(EXIT_FAILURE);
+		}
+
+		const double secs = std::chrono::duration<double>(total).count();
+		printf("%-14s %10.3f ms %10.1f MiB/s %8.1f ns/line\n", name, secs * 1000,
+			bytes * iterations / secs / (1024 * 1024), secs * 1e9 / (lines.size() * iterations));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string capture;
+	if (argc > 1)
+	{
+		std::ifstream stream(argv[1], std::ios::binary);
+		if (!stream)
+		{
+			fprintf(stderr, "Unable to open %s!\n", argv[1]);
+			return EXIT_FAILURE;
+		}
+		capture.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	}
+	else
+		capture = GenerateCapture();
+
+	const unsigned long iterations = argc > 2 ? strtoul(argv[2], nullptr, 10) : 100;
+	const std::vector<std::string> lines = SplitLines(capture);
+	if (lines.empty() || !iterations)
+	{
+		fprintf(stderr, "Nothing to benchmark!\n");
+		return EXIT_FAILURE;
+	}
+
+	size_t bytes = 0;
+	for (const auto& line : lines)
+		bytes += line.size();
+	printf("%zu lines, %zu bytes, %lu iterations\n", lines.size(), bytes, iterations);
+
+	std::vector<std::string> expected = lines;
+	for (auto& line : expected)
+		line.resize(CleanOld(line.data(), line.size()));
+
+	const std::vector<std::string> none;
+	Run("old loop", lines, bytes, iterations, none, CleanOld);
+	Run("clean scalar", lines, bytes, iterations, expected, [](char* data, size_t len) {
+		return insp::linescan::Clean(data, len, insp::linescan::FindScalar);
+	});
+#ifdef INSPIRCD_LINESCAN_SSE2
+	Run("clean sse2", lines, bytes, iterations, expected, [](char* data, size_t len) {
+		return insp::linescan::Clean(data, len, insp::linescan::FindSSE2);
+	});
+#endif
+#ifdef INSPIRCD_LINESCAN_AVX2
+	__builtin_cpu_init();
+	const bool avx2 = __builtin_cpu_supports("avx2");
+	if (avx2)
+	{
+		Run("clean avx2", lines, bytes, iterations, expected, [](char* data, size_t len) {
+			return insp::linescan::Clean(data, len, insp::linescan::FindAVX2);
+		});
+	}
+#endif
+
+	// The server to server protocol only looks for the first control character.
+	Run("find scalar", lines, bytes, iterations, none, insp::linescan::FindScalar);
+#ifdef INSPIRCD_LINESCAN_SSE2
+	Run("find sse2", lines, bytes, iterations, none, insp::linescan::FindSSE2);
+#endif
+#ifdef INSPIRCD_LINESCAN_AVX2
+	if (avx2)
+		Run("find avx2", lines, bytes, iterations, none, insp::linescan::FindAVX2);
+#endif
+	return EXIT_SUCCESS;
+}